@@ -0,0 +1,282 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "quicknet_bulktransfer.h"
+#include "quicknet_message.h"
+#include "quicknet_messagetypes.h"
+#include "quicknet_log.h"
+#include <algorithm>
+
+namespace quicknet
+{
+	// unacked chunks at once, about 280 KB with the smallest packets
+	static const uint32_t s_defaultWindow = 256;
+	// memory for incoming transfers of one remote peer
+	static const uint32_t s_defaultReceiveLimit = 64 * 1024 * 1024;
+	// an incoming transfer is dropped if no chunk arrives in this long
+	static const uint64_t s_transferTimeout = 10 * 1000 * 1000;
+	// finished transfer IDs remembered to ignore their late resends
+	static const uint32_t s_finishedMemory = 16;
+
+	BulkSender::BulkSender()
+		: m_transfers()
+		, m_nextTransferID(1)
+		, m_inFlight(0)
+		, m_window(s_defaultWindow)
+	{
+	}
+
+	BulkSender::~BulkSender()
+	{
+	}
+
+	uint16_t BulkSender::Add(std::shared_ptr<BulkSource> source, uint16_t chunkSize)
+	{
+		OutgoingTransfer transfer;
+		transfer.m_transferID = m_nextTransferID++;
+		transfer.m_chunkSize = chunkSize;
+		transfer.m_chunkCount = (source->Size() + chunkSize - 1) / chunkSize;
+		transfer.m_nextIndex = 0;
+		transfer.m_ackedBytes = 0;
+		transfer.m_moved = false;
+		transfer.m_source = std::move(source);
+
+		// 0 is never used
+		if (m_nextTransferID == 0)
+		{
+			m_nextTransferID = 1;
+		}
+
+		m_transfers.push_back(std::move(transfer));
+		return m_transfers.back().m_transferID;
+	}
+
+	bool BulkSender::HasChunkReady() const
+	{
+		if (m_inFlight >= m_window) { return false; }
+
+		for (const OutgoingTransfer& transfer : m_transfers)
+		{
+			if (transfer.m_nextIndex < transfer.m_chunkCount) { return true; }
+		}
+		return false;
+	}
+
+	std::unique_ptr<MessageBulkChunk> BulkSender::NextChunk(uint32_t maxSize)
+	{
+		if (m_inFlight >= m_window) { return nullptr; }
+
+		// one transfer after the other, so the first ones finish early
+		for (OutgoingTransfer& transfer : m_transfers)
+		{
+			if (transfer.m_nextIndex >= transfer.m_chunkCount) { continue; }
+
+			uint32_t offset = transfer.m_nextIndex * transfer.m_chunkSize;
+			uint32_t length = std::min((uint32_t)transfer.m_chunkSize, transfer.m_source->Size() - offset);
+			if ((MessageHeader::Size() + MessageBulkChunk::FixedSize() + length) > maxSize) { return nullptr; }
+
+			std::unique_ptr<MessageBulkChunk> chunk = MessageBulkChunk::Create();
+			chunk->m_transferID = transfer.m_transferID;
+			chunk->m_index = transfer.m_nextIndex;
+			chunk->m_chunkSize = transfer.m_chunkSize;
+			chunk->m_totalSize = transfer.m_source->Size();
+			chunk->m_length = (uint16_t)length;
+			chunk->m_source = transfer.m_source->Data() + offset;
+			chunk->m_sourceOwner = transfer.m_source;
+
+			transfer.m_nextIndex++;
+			m_inFlight++;
+			return chunk;
+		}
+		return nullptr;
+	}
+
+	void BulkSender::ChunkAcked(const MessageBulkChunk* chunk)
+	{
+		m_inFlight = (m_inFlight > 0) ? (m_inFlight - 1) : 0;
+
+		for (OutgoingTransfer& transfer : m_transfers)
+		{
+			if (transfer.m_transferID != chunk->m_transferID) { continue; }
+
+			transfer.m_ackedBytes += chunk->m_length;
+			transfer.m_moved = true;
+			return;
+		}
+	}
+
+	bool BulkSender::TakeProgress(std::vector<BulkTransferProgress>& progress)
+	{
+		progress.clear();
+		for (auto it = m_transfers.begin(); it != m_transfers.end();)
+		{
+			if (it->m_moved)
+			{
+				progress.push_back({ it->m_transferID, it->m_ackedBytes, it->m_source->Size() });
+				it->m_moved = false;
+			}
+
+			// every chunk acked, the source can go
+			if (it->m_ackedBytes >= it->m_source->Size())
+			{
+				it = m_transfers.erase(it);
+				continue;
+			}
+			it++;
+		}
+		return !progress.empty();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////
+
+	BulkReceiver::BulkReceiver()
+		: m_transfers()
+		, m_completed()
+		, m_finishedIDs()
+		, m_bytes(0)
+		, m_limit(s_defaultReceiveLimit)
+	{
+	}
+
+	BulkReceiver::~BulkReceiver()
+	{
+	}
+
+	bool BulkReceiver::AddChunk(const MessageBulkChunk* chunk, uint64_t now)
+	{
+		if (std::find(m_finishedIDs.begin(), m_finishedIDs.end(), chunk->m_transferID) != m_finishedIDs.end()) { return true; }
+
+		uint32_t totalSize = chunk->m_totalSize;
+		uint32_t chunkSize = chunk->m_chunkSize;
+		if (chunkSize == 0 || totalSize == 0)
+		{
+			Log::Warn("Received an invalid bulk chunk. Skipping");
+			return false;
+		}
+
+		uint32_t count = (totalSize + chunkSize - 1) / chunkSize;
+		uint64_t offset = (uint64_t)chunk->m_index * chunkSize;
+		uint32_t length = (chunk->m_index == count - 1) ? (totalSize - (uint32_t)offset) : chunkSize;
+		if (chunk->m_index >= count || chunk->m_data.size() != length)
+		{
+			Log::Warn("Received a bulk chunk with the wrong size. Skipping");
+			return false;
+		}
+
+		auto it = m_transfers.begin();
+		while (it != m_transfers.end() && it->m_transferID != chunk->m_transferID) { it++; }
+		if (it == m_transfers.end())
+		{
+			if (totalSize > m_limit || m_bytes > (m_limit - totalSize))
+			{
+				Log::Warn("Incoming bulk transfer doesn't fit in memory. Dropping");
+				return false;
+			}
+
+			IncomingTransfer transfer;
+			transfer.m_transferID = chunk->m_transferID;
+			transfer.m_chunkSize = chunk->m_chunkSize;
+			transfer.m_received = 0;
+			transfer.m_moved = false;
+			transfer.m_data.resize(totalSize);
+			transfer.m_arrived.assign(count, false);
+			m_bytes += totalSize;
+			m_transfers.push_back(std::move(transfer));
+			it = m_transfers.end() - 1;
+		}
+
+		if (it->m_chunkSize != chunkSize || it->m_data.size() != totalSize)
+		{
+			Log::Warn("Received a bulk chunk that doesn't match its transfer. Skipping");
+			return false;
+		}
+
+		it->m_lastTime = now;
+		if (it->m_arrived[chunk->m_index]) { return true; }
+
+		std::copy(chunk->m_data.begin(), chunk->m_data.end(), it->m_data.begin() + offset);
+		it->m_arrived[chunk->m_index] = true;
+		it->m_received += length;
+		it->m_moved = true;
+
+		if (it->m_received == totalSize)
+		{
+			m_finishedIDs.push_back(it->m_transferID);
+			if (m_finishedIDs.size() > s_finishedMemory)
+			{
+				m_finishedIDs.pop_front();
+			}
+			// still counted in memory until the game takes it
+			m_completed.push_back(std::move(*it));
+			m_transfers.erase(it);
+		}
+		return true;
+	}
+
+	void BulkReceiver::DropStale(uint64_t now)
+	{
+		for (auto it = m_transfers.begin(); it != m_transfers.end();)
+		{
+			if ((now - it->m_lastTime) <= s_transferTimeout)
+			{
+				it++;
+				continue;
+			}
+
+			Log::Warn("Incoming bulk transfer stopped getting data. Dropping");
+			m_bytes -= (uint32_t)it->m_data.size();
+			it = m_transfers.erase(it);
+		}
+	}
+
+	bool BulkReceiver::TakeProgress(std::vector<BulkTransferProgress>& progress)
+	{
+		progress.clear();
+		for (IncomingTransfer& transfer : m_transfers)
+		{
+			if (!transfer.m_moved) { continue; }
+
+			progress.push_back({ transfer.m_transferID, transfer.m_received, (uint32_t)transfer.m_data.size() });
+			transfer.m_moved = false;
+		}
+		for (IncomingTransfer& transfer : m_completed)
+		{
+			if (!transfer.m_moved) { continue; }
+
+			progress.push_back({ transfer.m_transferID, transfer.m_received, (uint32_t)transfer.m_data.size() });
+			transfer.m_moved = false;
+		}
+		return !progress.empty();
+	}
+
+	bool BulkReceiver::TakeCompleted(uint16_t& transferID, std::vector<uint8_t>& data)
+	{
+		if (m_completed.empty()) { return false; }
+
+		IncomingTransfer& transfer = m_completed.front();
+		transferID = transfer.m_transferID;
+		m_bytes -= (uint32_t)transfer.m_data.size();
+		data.swap(transfer.m_data);
+		m_completed.pop_front();
+		return true;
+	}
+}
\ No newline at end of file
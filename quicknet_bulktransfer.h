@@ -0,0 +1,163 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Bulk transfers stream big blocks of data (files, replays, level data) to a remote peer
+// They go in reliable chunks with a window of unacked ones, filling only what the game traffic leaves in the packets
+// Each chunk is written straight from the source memory into the send buffer
+//
+
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <string>
+#include "quicknet_mappedfile.h"
+
+namespace quicknet
+{
+	class MessageBulkChunk;
+
+	// memory a transfer is sent from
+	class BulkSource
+	{
+	public:
+		virtual ~BulkSource() {}
+
+		virtual const uint8_t* Data() const = 0;
+		virtual uint32_t Size() const = 0;
+	};
+
+	class BulkFileSource : public BulkSource
+	{
+	public:
+		bool Open(const std::string& path) { return m_file.Open(path); }
+
+		virtual const uint8_t* Data() const override { return m_file.Data(); }
+		virtual uint32_t Size() const override { return (uint32_t)m_file.Size(); }
+
+		// the whole file, even above what a transfer can carry
+		uint64_t FileSize() const { return m_file.Size(); }
+
+	private:
+		MappedFile m_file;
+	};
+
+	class BulkBlobSource : public BulkSource
+	{
+	public:
+		BulkBlobSource(std::vector<uint8_t> data) : m_data(std::move(data)) {}
+
+		virtual const uint8_t* Data() const override { return m_data.data(); }
+		virtual uint32_t Size() const override { return (uint32_t)m_data.size(); }
+
+	private:
+		std::vector<uint8_t> m_data;
+	};
+
+	struct BulkTransferProgress
+	{
+		uint16_t m_transferID;
+		uint32_t m_bytes; // acked or received so far
+		uint32_t m_total;
+	};
+
+	class BulkSender
+	{
+	public:
+		BulkSender();
+		~BulkSender();
+
+		// queue a transfer split in chunks of chunkSize bytes, returns its ID
+		uint16_t Add(std::shared_ptr<BulkSource> source, uint16_t chunkSize);
+		// something left to send and room in the window for it
+		bool HasChunkReady() const;
+		// next chunk if it fits in maxSize bytes, message header included
+		std::unique_ptr<MessageBulkChunk> NextChunk(uint32_t maxSize);
+		void ChunkAcked(const MessageBulkChunk* chunk);
+
+		// transfers that moved since the last call, the finished ones are forgotten after it
+		bool TakeProgress(std::vector<BulkTransferProgress>& progress);
+
+		// how many chunks can be unacked at once
+		void SetWindow(uint32_t chunks) { m_window = (chunks == 0) ? 1 : chunks; }
+		uint32_t ChunksInFlight() const { return m_inFlight; }
+
+	private:
+		struct OutgoingTransfer
+		{
+			uint16_t m_transferID;
+			std::shared_ptr<BulkSource> m_source;
+			uint16_t m_chunkSize;
+			uint32_t m_chunkCount;
+			uint32_t m_nextIndex;
+			uint32_t m_ackedBytes;
+			bool     m_moved;
+		};
+
+		std::deque<OutgoingTransfer> m_transfers;
+		uint16_t m_nextTransferID;
+		uint32_t m_inFlight;
+		uint32_t m_window;
+	};
+
+	class BulkReceiver
+	{
+	public:
+		BulkReceiver();
+		~BulkReceiver();
+
+		// put a received chunk in place, false if its invalid or the transfer doesnt fit in memory
+		bool AddChunk(const MessageBulkChunk* chunk, uint64_t now);
+		// give up on the transfers that stopped getting chunks
+		void DropStale(uint64_t now);
+
+		// transfers that moved since the last call
+		bool TakeProgress(std::vector<BulkTransferProgress>& progress);
+		// one finished transfer, false if there are none
+		bool TakeCompleted(uint16_t& transferID, std::vector<uint8_t>& data);
+
+		// memory the incoming transfers can take
+		void SetLimit(uint32_t bytes) { m_limit = bytes; }
+		uint32_t Bytes() const { return m_bytes; }
+
+	private:
+		struct IncomingTransfer
+		{
+			uint16_t m_transferID;
+			uint16_t m_chunkSize;
+			uint32_t m_received; // bytes
+			uint64_t m_lastTime;
+			bool     m_moved;
+			std::vector<uint8_t> m_data;
+			std::vector<bool> m_arrived;
+		};
+
+		std::deque<IncomingTransfer> m_transfers;
+		std::deque<IncomingTransfer> m_completed;
+		// late resends of finished transfers must not start them again
+		std::deque<uint16_t> m_finishedIDs;
+		uint32_t m_bytes;
+		uint32_t m_limit;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "quicknet_congestion.h"
+
+namespace quicknet
+{
+	// windows never go below this many packets, so acks keep coming
+	static const uint32_t s_minimumWindowPackets = 2;
+	static const uint32_t s_initialWindowPackets = 4;
+	static const uint32_t s_maximumWindow = 1024 * 1024;
+	// delivery rate is measured over at least this many microseconds
+	static const uint32_t s_minimumSampleTime = 100 * 1000;
+
+	AIMDController::AIMDController(uint32_t packetSize)
+		: m_packetSize(packetSize)
+		, m_window(packetSize * s_initialWindowPackets)
+		, m_slowStartThreshold(s_maximumWindow)
+		, m_recoveryStart(0)
+		, m_sampleStart(0)
+		, m_sampleBytes(0)
+		, m_bandwidth(0)
+	{
+	}
+
+	AIMDController::~AIMDController()
+	{
+	}
+
+	void AIMDController::OnPacketSent(uint32_t /*bytes*/, uint64_t now)
+	{
+		if (m_sampleStart == 0)
+		{
+			m_sampleStart = now;
+		}
+	}
+
+	void AIMDController::OnPacketAcked(uint32_t bytes, uint32_t rtt, uint64_t /*sendTime*/, uint64_t now)
+	{
+		// exponential growth until the first loss, then one packet per window
+		if (m_window < m_slowStartThreshold)
+		{
+			m_window += bytes;
+		}
+		else
+		{
+			uint32_t increase = (m_packetSize * bytes) / m_window;
+			m_window += (increase == 0) ? 1 : increase;
+		}
+		m_window = (m_window > s_maximumWindow) ? s_maximumWindow : m_window;
+
+		// bytes acked over about one round trip
+		m_sampleBytes += bytes;
+		uint64_t elapsed = now - m_sampleStart;
+		if (elapsed >= rtt && elapsed >= s_minimumSampleTime)
+		{
+			uint32_t rate = (uint32_t)(((uint64_t)m_sampleBytes * 1000 * 1000) / elapsed);
+			m_bandwidth = (m_bandwidth == 0) ? rate : ((m_bandwidth * 7) / 8) + (rate / 8);
+			m_sampleStart = now;
+			m_sampleBytes = 0;
+		}
+	}
+
+	void AIMDController::OnPacketLost(uint32_t /*bytes*/, uint64_t sendTime, uint64_t now)
+	{
+		// only halve once per loss event
+		if (sendTime < m_recoveryStart) { return; }
+
+		uint32_t minimum = m_packetSize * s_minimumWindowPackets;
+		m_slowStartThreshold = (m_window / 2 < minimum) ? minimum : m_window / 2;
+		m_window = m_slowStartThreshold;
+		m_recoveryStart = now;
+	}
+
+	void AIMDController::SetPacketSize(uint32_t bytes)
+	{
+		// growth and the minimum window are counted in packets of the new size
+		m_packetSize = bytes;
+		uint32_t minimum = m_packetSize * s_minimumWindowPackets;
+		m_window = (m_window < minimum) ? minimum : m_window;
+		m_slowStartThreshold = (m_slowStartThreshold < minimum) ? minimum : m_slowStartThreshold;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Congestion control for the traffic going to one remote peer
+// The controller decides how many bytes can be in flight (sent but not acked or lost yet)
+// RemotePeer feeds it the sent, acked and lost packets and Peer stops sending when the window is full
+//
+
+#pragma once
+#include <stdint.h>
+
+namespace quicknet
+{
+	class CongestionController
+	{
+	public:
+		virtual ~CongestionController() {}
+
+		virtual void OnPacketSent(uint32_t bytes, uint64_t now) = 0;
+		// times are in microseconds, rtt is the time from the send to the ack of this packet
+		virtual void OnPacketAcked(uint32_t bytes, uint32_t rtt, uint64_t sendTime, uint64_t now) = 0;
+		virtual void OnPacketLost(uint32_t bytes, uint64_t sendTime, uint64_t now) = 0;
+		// the path MTU search changed the size of the packets
+		virtual void SetPacketSize(uint32_t /*bytes*/) {}
+
+		// maximum bytes in flight
+		virtual uint32_t CongestionWindow() const = 0;
+		// delivery rate in bytes per second
+		virtual uint32_t Bandwidth() const = 0;
+	};
+
+	// additive increase, multiplicative decrease with slow start (TCP Reno like)
+	class AIMDController : public CongestionController
+	{
+	public:
+		AIMDController(uint32_t packetSize);
+		~AIMDController();
+
+		virtual void OnPacketSent(uint32_t bytes, uint64_t now) override;
+		virtual void OnPacketAcked(uint32_t bytes, uint32_t rtt, uint64_t sendTime, uint64_t now) override;
+		virtual void OnPacketLost(uint32_t bytes, uint64_t sendTime, uint64_t now) override;
+		virtual void SetPacketSize(uint32_t bytes) override;
+
+		virtual uint32_t CongestionWindow() const override { return m_window; }
+		virtual uint32_t Bandwidth() const override { return m_bandwidth; }
+
+	private:
+		uint32_t m_packetSize;
+		uint32_t m_window;
+		uint32_t m_slowStartThreshold;
+		// losses of packets sent before this belong to the last reduction
+		uint64_t m_recoveryStart;
+		// delivery rate sampling
+		uint64_t m_sampleStart;
+		uint32_t m_sampleBytes;
+		uint32_t m_bandwidth;
+	};
+}
\ No newline at end of file
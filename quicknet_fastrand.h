@@ -21,7 +21,8 @@ namespace quicknet
 
 		float GetFloat(float min = 0.0f, float max = 1.0f)
 		{
-			const float normalized = (float)fastrand() / (float)RAND_MAX;
+			// fastrand() gives 15 bits, RAND_MAX is not 0x7FFF everywhere
+			const float normalized = (float)fastrand() / (float)0x7FFF;
 			return min + normalized * (max - min);
 		}
 
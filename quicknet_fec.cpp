@@ -0,0 +1,225 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string.h>
+#include "quicknet_fec.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	include <emmintrin.h>
+#	define QUICKNET_XOR_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	include <arm_neon.h>
+#	define QUICKNET_XOR_NEON 1
+#endif
+
+namespace quicknet
+{
+	// limits for the adaptive group size (packets covered by one parity)
+	static const uint8_t s_minimumGroupSize = 2;
+	static const uint8_t s_maximumGroupSize = 16;
+
+	void XorBytes(uint8_t* dst, const uint8_t* src, uint32_t length)
+	{
+		uint32_t i = 0;
+#if QUICKNET_XOR_SSE2
+		// 64 bytes per iteration, then 16
+		for (; i + 64 <= length; i += 64)
+		{
+			__m128i a0 = _mm_loadu_si128((const __m128i*)(dst + i));
+			__m128i a1 = _mm_loadu_si128((const __m128i*)(dst + i + 16));
+			__m128i a2 = _mm_loadu_si128((const __m128i*)(dst + i + 32));
+			__m128i a3 = _mm_loadu_si128((const __m128i*)(dst + i + 48));
+			a0 = _mm_xor_si128(a0, _mm_loadu_si128((const __m128i*)(src + i)));
+			a1 = _mm_xor_si128(a1, _mm_loadu_si128((const __m128i*)(src + i + 16)));
+			a2 = _mm_xor_si128(a2, _mm_loadu_si128((const __m128i*)(src + i + 32)));
+			a3 = _mm_xor_si128(a3, _mm_loadu_si128((const __m128i*)(src + i + 48)));
+			_mm_storeu_si128((__m128i*)(dst + i), a0);
+			_mm_storeu_si128((__m128i*)(dst + i + 16), a1);
+			_mm_storeu_si128((__m128i*)(dst + i + 32), a2);
+			_mm_storeu_si128((__m128i*)(dst + i + 48), a3);
+		}
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, _mm_loadu_si128((const __m128i*)(src + i))));
+		}
+#elif QUICKNET_XOR_NEON
+		for (; i + 16 <= length; i += 16)
+		{
+			vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+		}
+#endif
+		// the remaining tail
+		for (; i < length; i++)
+		{
+			dst[i] ^= src[i];
+		}
+	}
+
+	uint8_t FECGroupSizeForLoss(float packetLoss)
+	{
+		// two losses in a group of K+1 happen with probability ~ (K^2 / 2) * loss^2
+		// keeping that around 5% gives K ~ 0.3 / loss
+		if (packetLoss <= (0.3f / s_maximumGroupSize)) { return s_maximumGroupSize; }
+
+		uint32_t size = (uint32_t)(0.3f / packetLoss);
+		return (size < s_minimumGroupSize) ? s_minimumGroupSize : (uint8_t)size;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////
+
+	FECEncoder::FECEncoder()
+		: m_group(0)
+		, m_index(0)
+		, m_count(0)
+		, m_lengthXor(0)
+		, m_parity()
+	{
+	}
+
+	FECEncoder::~FECEncoder()
+	{
+	}
+
+	void FECEncoder::NextPacket(uint8_t groupSize, uint16_t& group, uint8_t& index, uint8_t& count)
+	{
+		// last group is done, start another
+		if (m_index >= m_count)
+		{
+			m_group++;
+			m_index = 0;
+			m_count = groupSize;
+			m_lengthXor = 0;
+			m_parity.clear();
+		}
+
+		group = m_group;
+		index = m_index;
+		count = m_count;
+	}
+
+	bool FECEncoder::AddPacket(const uint8_t* data, uint32_t length)
+	{
+		// shorter packets are padded with zeros
+		if (m_parity.size() < length)
+		{
+			m_parity.resize(length, 0x00);
+		}
+
+		XorBytes(m_parity.data(), data, length);
+		m_lengthXor ^= (uint16_t)length;
+		m_index++;
+
+		return (m_index >= m_count);
+	}
+
+	bool FECEncoder::CloseGroup()
+	{
+		if (m_index == 0 || m_index >= m_count) { return false; }
+
+		// the receiver takes the count from the parity, not from the packet tags
+		m_count = m_index;
+		return true;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////
+
+	FECDecoder::FECDecoder()
+		: m_recovered(0)
+	{
+		for (FECGroupSlot& entry : m_slots)
+		{
+			entry.m_group = 0;
+			entry.m_count = 0;
+			entry.m_received = 0;
+			entry.m_lengthXor = 0;
+		}
+	}
+
+	FECDecoder::~FECDecoder()
+	{
+	}
+
+	bool FECDecoder::AddPacket(uint16_t group, uint8_t index, uint8_t count, const uint8_t* data, uint32_t length)
+	{
+		if (index >= count || count > 32) { return false; }
+
+		FECGroupSlot& entry = slot(group);
+		if (entry.m_count == 0) { entry.m_count = count; }
+
+		// duplicated or already rebuilt
+		if ((entry.m_received & (1u << index)) != 0) { return false; }
+
+		if (entry.m_data.size() < length)
+		{
+			entry.m_data.resize(length, 0x00);
+		}
+
+		XorBytes(entry.m_data.data(), data, length);
+		entry.m_lengthXor ^= (uint16_t)length;
+		entry.m_received |= (1u << index);
+
+		return true;
+	}
+
+	uint32_t FECDecoder::Recover(uint16_t group, uint8_t count, uint16_t lengthXor, const std::vector<uint8_t>& parity, uint8_t* output, uint32_t outputLength)
+	{
+		if (count == 0 || count > 32) { return 0; }
+
+		FECGroupSlot& entry = slot(group);
+		if (entry.m_count == 0) { entry.m_count = count; }
+
+		// XOR can only fill one hole
+		uint32_t all = (count == 32) ? 0xFFFFFFFF : ((1u << count) - 1);
+		uint32_t missing = all & ~entry.m_received;
+		if (missing == 0 || (missing & (missing - 1)) != 0) { return 0; }
+
+		uint32_t length = entry.m_lengthXor ^ lengthXor;
+		if (length == 0 || length > parity.size() || length > outputLength) { return 0; }
+
+		memcpy(output, parity.data(), length);
+		if (!entry.m_data.empty())
+		{
+			XorBytes(output, entry.m_data.data(), (entry.m_data.size() < length) ? (uint32_t)entry.m_data.size() : length);
+		}
+
+		// mark it as received so the original is ignored if it arrives late
+		entry.m_received = all;
+		m_recovered++;
+
+		return length;
+	}
+
+	FECDecoder::FECGroupSlot& FECDecoder::slot(uint16_t group)
+	{
+		FECGroupSlot& entry = m_slots[group % s_slotCount];
+		if (entry.m_group != group)
+		{
+			entry.m_group = group;
+			entry.m_count = 0;
+			entry.m_received = 0;
+			entry.m_lengthXor = 0;
+			entry.m_data.clear();
+		}
+		return entry;
+	}
+}
\ No newline at end of file
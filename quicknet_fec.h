@@ -0,0 +1,102 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Forward error correction with XOR parity over groups of outgoing packets
+// One parity packet per group lets the receiver rebuild any single lost packet of that group
+// without waiting a full retransmission timeout
+//
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace quicknet
+{
+	// dst ^= src, vectorized when the platform allows it
+	void XorBytes(uint8_t* dst, const uint8_t* src, uint32_t length);
+
+	// group size that keeps two losses in one group unlikely for the given loss rate
+	uint8_t FECGroupSizeForLoss(float packetLoss);
+
+	class FECEncoder
+	{
+	public:
+		FECEncoder();
+		~FECEncoder();
+
+		// group info for the next outgoing packet, starting a new group of groupSize packets if needed
+		void NextPacket(uint8_t groupSize, uint16_t& group, uint8_t& index, uint8_t& count);
+		// add a serialized packet to the parity, returns true when its group is complete
+		bool AddPacket(const uint8_t* data, uint32_t length);
+		// end the current group with the packets it got so far, false if it has none or is already complete
+		// the parity then covers only those, so the tail of a burst is protected too
+		bool CloseGroup();
+
+		// parity of the current group
+		uint16_t Group() const { return m_group; }
+		uint8_t  Count() const { return m_count; }
+		uint16_t LengthXor() const { return m_lengthXor; }
+		const std::vector<uint8_t>& Parity() const { return m_parity; }
+
+	private:
+		uint16_t m_group;
+		uint8_t  m_index;
+		uint8_t  m_count;
+		uint16_t m_lengthXor;
+		// XOR of all the packets in the group, as long as the longest one
+		std::vector<uint8_t> m_parity;
+	};
+
+	class FECDecoder
+	{
+	public:
+		FECDecoder();
+		~FECDecoder();
+
+		// add a received packet to its group, false if it was already there
+		bool AddPacket(uint16_t group, uint8_t index, uint8_t count, const uint8_t* data, uint32_t length);
+		// rebuild the only missing packet of a group into output, returns its length or 0 if not possible
+		uint32_t Recover(uint16_t group, uint8_t count, uint16_t lengthXor, const std::vector<uint8_t>& parity, uint8_t* output, uint32_t outputLength);
+
+		// how many packets were rebuilt so far
+		uint64_t Recovered() const { return m_recovered; }
+
+	private:
+		struct FECGroupSlot
+		{
+			uint16_t m_group;
+			uint8_t  m_count;
+			uint32_t m_received; // one bit per packet index
+			uint16_t m_lengthXor;
+			std::vector<uint8_t> m_data; // XOR of the received packets
+		};
+
+		// slot for a group, reset if it was holding an older one
+		FECGroupSlot& slot(uint16_t group);
+
+		// a few groups in flight are enough to handle reordering
+		static const uint32_t s_slotCount = 4;
+		FECGroupSlot m_slots[s_slotCount];
+		uint64_t m_recovered;
+	};
+}
\ No newline at end of file
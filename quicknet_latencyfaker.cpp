@@ -22,7 +22,6 @@
 
 #include "quicknet_latencyfaker.h"
 #include "quicknet_remotepeer.h"
-#include "quicknet_time.h"
 
 namespace quicknet
 {
@@ -41,7 +40,7 @@ namespace quicknet
 		m_entries.clear();
 	}
 
-	void NetLatencyFaker::GetMessageReady(std::unique_ptr<Message>& message, Address& address)
+	void NetLatencyFaker::GetMessageReady(std::unique_ptr<Message>& message, Address& address, uint64_t now)
 	{
 		if (m_entries.empty())
 		{
@@ -50,7 +49,7 @@ namespace quicknet
 		}
 
 		NetLatencyFakerEntry& entry = m_entries.front();
-		if (shouldArrive(entry))
+		if (shouldArrive(entry, now))
 		{
 			message = std::unique_ptr<Message>(entry.m_message);
 			address = entry.m_address;
@@ -62,24 +61,22 @@ namespace quicknet
 		}
 	}
 
-	void NetLatencyFaker::AddPendingMessage(std::unique_ptr<Message> message, RemotePeer* peer)
+	void NetLatencyFaker::AddPendingMessage(std::unique_ptr<Message> message, RemotePeer* peer, uint64_t now)
 	{
 		NetLatencyFakerEntry entry;
 		entry.m_message = message.release();
 		entry.m_address = peer->Address();
-		entry.m_timeStamp = Utils::GetElapsedMilliseconds();
+		entry.m_timeStamp = now;
 
 		m_entries.push_back(std::move(entry));
 	}
 
-	bool NetLatencyFaker::shouldArrive(const NetLatencyFakerEntry& entry)
+	bool NetLatencyFaker::shouldArrive(const NetLatencyFakerEntry& entry, uint64_t now)
 	{
 		// if fake latency is off, validate all messages
 		if (m_latency == 0) { return true; }
 
-		// how many ticks elapsed since arrival
-		uint32_t diff = (uint32_t)(Utils::GetElapsedMilliseconds() - entry.m_timeStamp);
-
-		return (diff >= m_latency);
+		// how long since arrival
+		return (now - entry.m_timeStamp) >= (uint64_t)m_latency * 1000;
 	}
 }
\ No newline at end of file
@@ -42,7 +42,7 @@ namespace quicknet
 	public:
 		Message*	m_message;   // the actual message
 		Address		m_address;   // where did it come from
-		uint64_t	m_timeStamp; // when did it arrive
+		uint64_t	m_timeStamp; // when did it arrive (microseconds)
 	};
 
 	class NetLatencyFaker
@@ -54,13 +54,13 @@ namespace quicknet
 		void SetLatency(uint32_t milliseconds) { m_latency = milliseconds; }
 		uint32_t CurrentLatency() const { return m_latency; }
 
-		// get a message which timestamp expired within the fake latency
-		void GetMessageReady(std::unique_ptr<Message>& message, Address& address);
+		// get a message which timestamp expired within the fake latency, now in microseconds
+		void GetMessageReady(std::unique_ptr<Message>& message, Address& address, uint64_t now);
 		// add a new message to the queue waiting to "arrive"
-		void AddPendingMessage(std::unique_ptr<Message> message, RemotePeer* peer);
+		void AddPendingMessage(std::unique_ptr<Message> message, RemotePeer* peer, uint64_t now);
 
 	private:
-		bool shouldArrive(const NetLatencyFakerEntry& entry);
+		bool shouldArrive(const NetLatencyFakerEntry& entry, uint64_t now);
 
 		// fake latency set
 		uint32_t m_latency;
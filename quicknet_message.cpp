@@ -31,6 +31,8 @@ namespace quicknet
 		, m_sequence(0)
 		, m_flags(0)
 		, m_messageID(0)
+		, m_channel(0)
+		, m_channelSequence(0)
 	{
 	}
 
@@ -39,6 +41,8 @@ namespace quicknet
 		, m_sequence(sequence)
 		, m_flags(flags)
 		, m_messageID(id)
+		, m_channel(0)
+		, m_channelSequence(0)
 	{
 	}
 
@@ -65,6 +69,11 @@ namespace quicknet
 		success = success && stream.ReadUShort(m_sequence);
 		success = success && stream.ReadByte(m_flags);
 		success = success && stream.ReadByte(m_messageID);
+		if (success && IsChanneled())
+		{
+			success = success && stream.ReadByte(m_channel);
+			success = success && stream.ReadUShort(m_channelSequence);
+		}
 
 		return success;
 	}
@@ -76,6 +85,11 @@ namespace quicknet
 		success = success && stream.WriteUShort(m_sequence);
 		success = success && stream.WriteByte(m_flags);
 		success = success && stream.WriteByte(m_messageID);
+		if (success && IsChanneled())
+		{
+			success = success && stream.WriteByte(m_channel);
+			success = success && stream.WriteUShort(m_channelSequence);
+		}
 
 		return success;
 	}
@@ -100,6 +114,21 @@ namespace quicknet
 		return flagCheck(m_flags, s_flagSystem);
 	}
 
+	bool MessageHeader::IsRedundant() const
+	{
+		return flagCheck(m_flags, s_flagRedundant);
+	}
+
+	bool MessageHeader::IsDelta() const
+	{
+		return flagCheck(m_flags, s_flagDelta);
+	}
+
+	bool MessageHeader::IsChanneled() const
+	{
+		return flagCheck(m_flags, s_flagChannel);
+	}
+
 	////////////////////////////////////////////////////////////////////////////////////////
 
 	bool Message::FromBuffer(uint8_t* data, uint32_t length)
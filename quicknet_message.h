@@ -38,6 +38,12 @@ namespace quicknet
 	static const uint32_t s_flagReliable	= (0x01 << 1);
 	static const uint32_t s_flagOrdered		= (0x01 << 2);
 	static const uint32_t s_flagUnsequenced = (0x01 << 3);
+	static const uint32_t s_flagRedundant	= (0x01 << 4);
+	// only on the wire, payload is a delta against the previous message of the same kind
+	static const uint32_t s_flagDelta		= (0x01 << 5);
+	// sent on a numbered channel, the header carries the channel and its own sequence
+	// (reliable & ordered then tell the channel mode instead of the message kind)
+	static const uint32_t s_flagChannel		= (0x01 << 6);
 
 	static void bitSet(uint32_t* bitfield, uint32_t bit)	{ *bitfield |= (1 << bit); }
 	static void bitClear(uint32_t* bitfield, uint32_t bit)	{ *bitfield &= ~(1 << bit); }
@@ -67,20 +73,31 @@ namespace quicknet
 		bool IsOrdered() const;
 		// is it a management or a game message?
 		bool IsSystem() const;
+		// should the last unacked copies go in every packet?
+		bool IsRedundant() const;
+		// is the payload delta encoded?
+		bool IsDelta() const;
+		// does it go through a numbered channel?
+		bool IsChanneled() const;
 
 		// total header size
 		static uint32_t Size() { return (sizeof(uint16_t) * 2) + (sizeof(uint8_t) * 2); }
+		// extra size of the channel fields, only written on channeled messages
+		static uint32_t ChannelSize() { return sizeof(uint16_t) + sizeof(uint8_t); }
 
 		uint16_t m_size; // does not include header size
 		uint16_t m_sequence;
 		uint8_t  m_flags;
 		uint8_t  m_messageID;
+		uint8_t  m_channel;
+		uint16_t m_channelSequence;
 	};
 
 	class Message
 	{
 	public:
-		Message() : m_header() {}
+		Message() : m_header(), m_deadline(0), m_handle(0), m_channel(0), m_urgent(false), m_key(0), m_sendBy(0), m_queuedReliable(false) {}
+		virtual ~Message() {}
 
 		virtual MessageHeader GenerateHeader() = 0;
 
@@ -92,10 +109,28 @@ namespace quicknet
 
 		virtual void CopyTo(Message* other) = 0;
 
-		virtual uint16_t Size() const = 0;
+		// serialized size, messages bigger than a packet are sent in fragments
+		virtual uint32_t Size() const = 0;
 		virtual std::string Name() const = 0;
+		// size on the wire, header included
+		uint32_t WireSize() const { return MessageHeader::Size() + ((m_channel != 0) ? MessageHeader::ChannelSize() : 0) + Size(); }
 
 		MessageHeader m_header;
+		// local time in microseconds after which sending it is pointless (0 never expires)
+		uint64_t m_deadline;
+		// set by the game to be told when the message is acked or lost (0 is not tracked, nor unsequenced ones)
+		uint32_t m_handle;
+		// set by the game to send it through a numbered channel (0 follows the message flags like always)
+		uint8_t m_channel;
+		// set by the game to send it right away, along with anything else queued, instead of on the next send round
+		bool m_urgent;
+		// set by the game to send only the latest of its messages with this key on the channel (0 sends every one)
+		// a newer one replaces a queued one in place, and the unacked redundant copies of the older ones stop going out
+		uint32_t m_key;
+		// set by the peer when queued, its place in the send order: the deadline, or a grace period after queuing without one
+		uint64_t m_sendBy;
+		// set by the peer when queued, if it goes out reliable on its channel
+		bool m_queuedReliable;
 	};
 
 }
\ No newline at end of file
@@ -52,6 +52,11 @@ break
 			CASE_GET_MESSAGE_FROM_ID(ConnectionSuccess);
 			CASE_GET_MESSAGE_FROM_ID(KeepAlive);
 			CASE_GET_MESSAGE_FROM_ID(DisconnectionRequest);
+			CASE_GET_MESSAGE_FROM_ID(FECGroup);
+			CASE_GET_MESSAGE_FROM_ID(FECParity);
+			CASE_GET_MESSAGE_FROM_ID(MTUProbe);
+			CASE_GET_MESSAGE_FROM_ID(Fragment);
+			CASE_GET_MESSAGE_FROM_ID(BulkChunk);
 
 			// game messages
 			// Insert your game messages here.
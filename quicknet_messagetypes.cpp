@@ -102,6 +102,100 @@ namespace quicknet
 
 	/////////////////////////////////////////////////////////////////////
 
+	bool MessageFECGroup::DeSerialize(Stream& stream)
+	{
+		bool success = true;
+		success = success && stream.DeSerializeUShort(m_group);
+		success = success && stream.DeSerializeByte(m_index);
+		success = success && stream.DeSerializeByte(m_count);
+		return success;
+	}
+
+	/////////////////////////////////////////////////////////////////////
+
+	bool MessageFECParity::DeSerialize(Stream& stream)
+	{
+		bool success = true;
+		uint16_t length = (uint16_t)m_parity.size();
+		success = success && stream.DeSerializeUShort(m_group);
+		success = success && stream.DeSerializeByte(m_count);
+		success = success && stream.DeSerializeUShort(m_lengthXor);
+		success = success && stream.DeSerializeUShort(length);
+		if (success)
+		{
+			m_parity.resize(length);
+			success = stream.DeSerializeBytes(m_parity.data(), length);
+		}
+		return success;
+	}
+
+	/////////////////////////////////////////////////////////////////////
+
+	bool MessageMTUProbe::DeSerialize(Stream& stream)
+	{
+		bool success = true;
+		uint16_t length = (uint16_t)m_padding.size();
+		success = success && stream.DeSerializeUShort(length);
+		if (success)
+		{
+			m_padding.resize(length);
+			success = stream.DeSerializeBytes(m_padding.data(), length);
+		}
+		return success;
+	}
+
+	/////////////////////////////////////////////////////////////////////
+
+	bool MessageFragment::DeSerialize(Stream& stream)
+	{
+		bool success = true;
+		uint16_t length = (uint16_t)m_data.size();
+		success = success && stream.DeSerializeUShort(m_fragmentID);
+		success = success && stream.DeSerializeUShort(m_index);
+		success = success && stream.DeSerializeUShort(m_count);
+		success = success && stream.DeSerializeUInt(m_totalSize);
+		success = success && stream.DeSerializeByte(m_messageID);
+		success = success && stream.DeSerializeUShort(length);
+		if (success)
+		{
+			m_data.resize(length);
+			success = stream.DeSerializeBytes(m_data.data(), length);
+		}
+		return success;
+	}
+
+	/////////////////////////////////////////////////////////////////////
+
+	bool MessageBulkChunk::FromStream(Stream& stream)
+	{
+		bool success = true;
+		success = success && stream.ReadUShort(m_transferID);
+		success = success && stream.ReadUInt(m_index);
+		success = success && stream.ReadUShort(m_chunkSize);
+		success = success && stream.ReadUInt(m_totalSize);
+		success = success && stream.ReadUShort(m_length);
+		if (success)
+		{
+			m_data.resize(m_length);
+			success = stream.ReadBytes(m_data.data(), m_length);
+		}
+		return success;
+	}
+
+	bool MessageBulkChunk::ToStream(Stream& stream)
+	{
+		bool success = true;
+		success = success && stream.WriteUShort(m_transferID);
+		success = success && stream.WriteUInt(m_index);
+		success = success && stream.WriteUShort(m_chunkSize);
+		success = success && stream.WriteUInt(m_totalSize);
+		success = success && stream.WriteUShort(m_length);
+		success = success && stream.WriteBytes(m_source, m_length);
+		return success;
+	}
+
+	/////////////////////////////////////////////////////////////////////
+
 	/////////////////////////////////////////////////////////////////////
 
 	// Implement de-serialization for game specific messages here.
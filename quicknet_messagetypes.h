@@ -31,6 +31,7 @@
 namespace quicknet
 {
 	class Stream;
+	class BulkSource;
 
 	// all the packet IDs are defined here
 	enum MessageIDs
@@ -45,6 +46,11 @@ namespace quicknet
 		ConnectionSuccess,
 		KeepAlive,
 		DisconnectionRequest,
+		FECGroup,
+		FECParity,
+		MTUProbe,
+		Fragment,
+		BulkChunk,
 		// game messages
 		// Add custom messages here.
 		COUNT
@@ -72,7 +78,7 @@ namespace quicknet
 			virtual bool								ToStream(Stream& stream) override		{ return DeSerialize(stream); } \
 			bool										DeSerialize(Stream& stream); \
 			virtual void								CopyTo(Message* other) override			{ Message ## name* copy = (Message ## name*)other; *copy = *this; } \
-			virtual uint16_t							Size() const override					{ return size; } \
+			virtual uint32_t							Size() const override					{ return size; } \
 			virtual std::string							Name() const override					{ return std::string("" #name); }
 
 #define DEFINE_QUICKNETMESSAGE_END }
@@ -118,6 +124,107 @@ namespace quicknet
 	uint32_t m_gameID; // specific ID to keep structure with Connection request
 	DEFINE_QUICKNETMESSAGE_END;
 
+	DEFINE_QUICKNETMESSAGE_START(FECGroup, 4, (s_flagSystem | s_flagUnsequenced));
+	uint16_t m_group; // which parity group this packet belongs to
+	uint8_t  m_index; // position inside the group
+	uint8_t  m_count; // packets in the group
+	DEFINE_QUICKNETMESSAGE_END;
+
+	// the parity is as long as the longest packet of its group, so it can't use the fixed size macro
+	class MessageFECParity : public Message
+	{
+	public:
+		static std::unique_ptr<MessageFECParity>	Create()								{ return std::unique_ptr<MessageFECParity>(new MessageFECParity()); }
+		virtual MessageHeader						GenerateHeader() override				{ return MessageHeader(Size(), 0x00, (s_flagSystem | s_flagUnsequenced), MessageIDs::FECParity); }
+		virtual bool								FromStream(Stream& stream) override		{ return DeSerialize(stream); }
+		virtual bool								ToStream(Stream& stream) override		{ return DeSerialize(stream); }
+		bool										DeSerialize(Stream& stream);
+		virtual void								CopyTo(Message* other) override			{ MessageFECParity* copy = (MessageFECParity*)other; *copy = *this; }
+		virtual uint32_t							Size() const override					{ return FixedSize() + (uint32_t)m_parity.size(); }
+		virtual std::string							Name() const override					{ return std::string("FECParity"); }
+
+		// size without the parity bytes
+		static uint16_t FixedSize() { return 7; }
+
+		uint16_t m_group;
+		uint8_t  m_count;
+		uint16_t m_lengthXor; // XOR of all the packet lengths
+		std::vector<uint8_t> m_parity;
+	};
+
+	// padded to the datagram size being probed, if its acked that size gets through the path
+	class MessageMTUProbe : public Message
+	{
+	public:
+		static std::unique_ptr<MessageMTUProbe>	Create()								{ return std::unique_ptr<MessageMTUProbe>(new MessageMTUProbe()); }
+		virtual MessageHeader						GenerateHeader() override				{ return MessageHeader(Size(), 0x00, s_flagSystem, MessageIDs::MTUProbe); }
+		virtual bool								FromStream(Stream& stream) override		{ return DeSerialize(stream); }
+		virtual bool								ToStream(Stream& stream) override		{ return DeSerialize(stream); }
+		bool										DeSerialize(Stream& stream);
+		virtual void								CopyTo(Message* other) override			{ MessageMTUProbe* copy = (MessageMTUProbe*)other; *copy = *this; }
+		virtual uint32_t							Size() const override					{ return FixedSize() + (uint32_t)m_padding.size(); }
+		virtual std::string							Name() const override					{ return std::string("MTUProbe"); }
+
+		// size without the padding
+		static uint16_t FixedSize() { return 2; }
+
+		std::vector<uint8_t> m_padding;
+	};
+
+	// one piece of a message too big for a packet, the receiver puts them back together
+	class MessageFragment : public Message
+	{
+	public:
+		static std::unique_ptr<MessageFragment>	Create()								{ return std::unique_ptr<MessageFragment>(new MessageFragment()); }
+		virtual MessageHeader						GenerateHeader() override				{ return MessageHeader(Size(), 0x00, m_reliable ? (s_flagSystem | s_flagReliable) : s_flagSystem, MessageIDs::Fragment); }
+		virtual bool								FromStream(Stream& stream) override		{ return DeSerialize(stream); }
+		virtual bool								ToStream(Stream& stream) override		{ return DeSerialize(stream); }
+		bool										DeSerialize(Stream& stream);
+		virtual void								CopyTo(Message* other) override			{ MessageFragment* copy = (MessageFragment*)other; *copy = *this; }
+		virtual uint32_t							Size() const override					{ return FixedSize() + (uint32_t)m_data.size(); }
+		virtual std::string							Name() const override					{ return std::string("Fragment"); }
+
+		// size without the data
+		static uint16_t FixedSize() { return 13; }
+
+		uint16_t m_fragmentID; // the same for all the pieces of one message
+		uint16_t m_index;
+		uint16_t m_count;
+		uint32_t m_totalSize;  // of the whole serialized message
+		uint8_t  m_messageID;  // of the whole message
+		std::vector<uint8_t> m_data;
+		// not serialized, the pieces are as reliable as the whole message
+		bool m_reliable;
+	};
+
+	// a piece of a bulk transfer, written to the packet straight from the source memory
+	class MessageBulkChunk : public Message
+	{
+	public:
+		static std::unique_ptr<MessageBulkChunk>	Create()								{ return std::unique_ptr<MessageBulkChunk>(new MessageBulkChunk()); }
+		virtual MessageHeader						GenerateHeader() override				{ return MessageHeader(Size(), 0x00, (s_flagSystem | s_flagReliable), MessageIDs::BulkChunk); }
+		// reading and writing use different buffers, so they dont share DeSerialize
+		virtual bool								FromStream(Stream& stream) override;
+		virtual bool								ToStream(Stream& stream) override;
+		virtual void								CopyTo(Message* other) override			{ MessageBulkChunk* copy = (MessageBulkChunk*)other; *copy = *this; }
+		virtual uint32_t							Size() const override					{ return FixedSize() + m_length; }
+		virtual std::string							Name() const override					{ return std::string("BulkChunk"); }
+
+		// size without the data
+		static uint16_t FixedSize() { return 14; }
+
+		uint16_t m_transferID;
+		uint32_t m_index;
+		uint16_t m_chunkSize; // every chunk has this size but the last one
+		uint32_t m_totalSize;
+		uint16_t m_length;
+		// where the data is read to
+		std::vector<uint8_t> m_data;
+		// where the data is written from, the source is kept alive while the chunk can be resent
+		const uint8_t* m_source;
+		std::shared_ptr<BulkSource> m_sourceOwner;
+	};
+
 	//////////////////////////////////////////////////////////////////////////////////////////////////
 	// GAME MESSAGES
 	//////////////////////////////////////////////////////////////////////////////////////////////////
@@ -20,6 +20,7 @@
 // OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
 // EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <unordered_map>
 #include "quicknet_packet.h"
 #include "quicknet_message.h"
 #include "quicknet_stream.h"
@@ -59,6 +60,8 @@ namespace quicknet
 		success = success && stream.ReadUShort(m_checksum);
 		success = success && stream.ReadUShort(m_ackseq);
 		success = success && stream.ReadUInt(m_ackbits);
+		success = success && stream.ReadUShort(m_timestamp);
+		success = success && stream.ReadUShort(m_echoTimestamp);
 
 		return success;
 	}
@@ -69,6 +72,8 @@ namespace quicknet
 		success = success && stream.WriteUShort(m_checksum);
 		success = success && stream.WriteUShort(m_ackseq);
 		success = success && stream.WriteUInt(m_ackbits);
+		success = success && stream.WriteUShort(m_timestamp);
+		success = success && stream.WriteUShort(m_echoTimestamp);
 
 		return success;
 	}
@@ -90,6 +95,9 @@ namespace quicknet
 	////////////////////////////////////////////////////////////////////////////////////////
 
 	Packet::Packet()
+		: m_size(PacketHeader::Size())
+		, m_newestSequence(0)
+		, m_sequenced(false)
 	{
 	}
 
@@ -97,7 +105,12 @@ namespace quicknet
 	{
 	}
 
-	void Packet::GeneratePacketHeader(RemotePeer* peer)
+	void Packet::GeneratePacketHeader(RemotePeer* peer, uint64_t now)
+	{
+		GeneratePacketHeader(peer, (peer == nullptr) ? 0x00 : peer->CurrentSequenceIn(), now);
+	}
+
+	void Packet::GeneratePacketHeader(RemotePeer* peer, uint16_t ackSequence, uint64_t now)
 	{
 		// checksum is computed later
 		m_header.m_checksum = 0x00;
@@ -106,11 +119,15 @@ namespace quicknet
 		{
 			m_header.m_ackseq = 0x00;
 			m_header.m_ackbits = 0x00;
+			m_header.m_timestamp = 0x00;
+			m_header.m_echoTimestamp = 0x00;
 		}
 		else
 		{
-			m_header.m_ackseq = peer->CurrentSequenceIn();
-			m_header.m_ackbits = peer->GetAckBits();
+			m_header.m_ackseq = ackSequence;
+			m_header.m_ackbits = peer->GetAckBits(ackSequence);
+			m_header.m_timestamp = peer->LocalTimestamp(now);
+			m_header.m_echoTimestamp = peer->EchoTimestamp(now);
 		}
 	}
 
@@ -121,42 +138,113 @@ namespace quicknet
 			// if the message has a sequence
 			if (message->m_header.m_sequence != 0x00)
 			{
+				trackNewestSequence(message->m_header.m_sequence, peer);
 				// skip it, because its an ack-pending reliable
 				continue;
 			}
 
-			MessageHeader header = message->GenerateHeader();
-			message->m_header = header;
+			// the channel numbers a message only once, the receiver waits for that number
+			MessageHeader numbered = message->m_header;
+			message->m_header = message->GenerateHeader();
+			// the channel decides how it's delivered and numbers it in its own order
+			if (peer != nullptr && message->m_channel != 0)
+			{
+				if (numbered.IsChanneled() && numbered.m_channel == message->m_channel)
+				{
+					message->m_header.m_flags = numbered.m_flags;
+					message->m_header.m_channel = numbered.m_channel;
+					message->m_header.m_channelSequence = numbered.m_channelSequence;
+				}
+				else
+				{
+					peer->ApplyChannel(message->m_header, message->m_channel);
+				}
+			}
+			const MessageHeader& header = message->m_header;
 
-			if (peer != nullptr)
+			// unsequenced messages are never tracked, so they dont spend sequences
+			if (peer != nullptr && !header.IsUnsequenced())
 			{
-				// increase the sequence with every message
+				// increase the sequence with every message, skipping 0 on the wrap since it marks the ones not sequenced yet
 				message->m_header.m_sequence = peer->CurrentSequenceOut();
-				peer->SetSequenceOut(peer->CurrentSequenceOut() + 1);
+				uint16_t next = peer->CurrentSequenceOut() + 1;
+				peer->SetSequenceOut((next == 0) ? 1 : next);
+
+				if (message->m_handle != 0)
+				{
+					peer->TrackHandle(message->m_header.m_sequence, message->m_handle, header.IsReliable());
+				}
+				trackNewestSequence(message->m_header.m_sequence, peer);
 			}
 		}
 	}
 
+	void Packet::trackNewestSequence(uint16_t sequence, RemotePeer* peer)
+	{
+		if (peer == nullptr) { return; }
+
+		if (!m_sequenced || peer->IsSequenceNewer(sequence, m_newestSequence))
+		{
+			m_newestSequence = sequence;
+			m_sequenced = true;
+		}
+	}
+
 	bool Packet::AddMessage(std::unique_ptr<Message> message)
 	{
 		if (!message) { return false; }
 
+		m_size += message->WireSize();
 		m_messages.push_back(std::move(message));
+		m_deltas.push_back(std::vector<uint8_t>());
 		return true;
 	}
 
-	void Packet::BackupReliables(RemotePeer* peer)
+	void Packet::BackupReliables(RemotePeer* peer, uint64_t now)
 	{
 		// packet is destroyed right after, so we can move the messages freely
 		for (std::unique_ptr<Message>& message : m_messages)
 		{
-			if (message->m_header.IsReliable())
+			// redundant ones are kept too, to go again in the next packets
+			if (message->m_header.IsReliable() || message->m_header.IsRedundant())
 			{
-				peer->RequeueMessage(std::move(message));
+				peer->RequeueMessage(std::move(message), now);
 			}
 		}
 	}
 
+	void Packet::EncodeDeltas()
+	{
+		// last serialized payload of each redundant message kind
+		std::unordered_map<uint8_t, std::vector<uint8_t>> references;
+		std::vector<uint8_t> payload;
+		std::vector<uint8_t> encoded;
+
+		for (uint32_t i = 0; i < m_messages.size(); i++)
+		{
+			Message* message = m_messages[i].get();
+			if (!message->m_header.IsRedundant()) { continue; }
+
+			payload.resize(message->Size());
+			if (!message->ToBuffer(payload.data(), (uint32_t)payload.size())) { continue; }
+
+			auto reference = references.find(message->m_header.m_messageID);
+			if (reference != references.end() && reference->second.size() == payload.size())
+			{
+				encoded.resize(payload.size() + (payload.size() / 8) + 1);
+				uint32_t length = DeltaEncode(payload.data(), reference->second.data(), (uint32_t)payload.size(), encoded.data());
+				if (length < payload.size())
+				{
+					m_deltas[i].assign(encoded.begin(), encoded.begin() + length);
+					m_size -= (uint32_t)payload.size() - length;
+				}
+			}
+
+			// the receiver decodes against the full payload, not the encoded one
+			references[message->m_header.m_messageID] = payload;
+		}
+	}
+
 	bool Packet::ToBuffer(uint8_t* data, uint32_t length)
 	{
 		Stream stream(data, length, NetStreamMode::Write);
@@ -176,10 +264,22 @@ namespace quicknet
 		bool success = true;
 		// write everything in order
 		success = success && m_header.ToStream(stream);
-		for (std::unique_ptr<Message>& message : m_messages)
+		for (uint32_t i = 0; i < m_messages.size(); i++)
 		{
-			success = success && message->m_header.ToStream(stream);
-			success = success && message->ToStream(stream);
+			std::unique_ptr<Message>& message = m_messages[i];
+			if (m_deltas[i].empty())
+			{
+				success = success && message->m_header.ToStream(stream);
+				success = success && message->ToStream(stream);
+			}
+			else
+			{
+				MessageHeader header = message->m_header;
+				header.m_flags |= s_flagDelta;
+				header.m_size = (uint16_t)m_deltas[i].size();
+				success = success && header.ToStream(stream);
+				success = success && stream.WriteBytes(m_deltas[i].data(), (uint32_t)m_deltas[i].size());
+			}
 		}
 
 		return success;
@@ -187,14 +287,47 @@ namespace quicknet
 
 	uint32_t Packet::Size()
 	{
-		// TODO: maybe cache the size once computed?
-		uint32_t size = PacketHeader::Size();
-		for (const std::unique_ptr<Message>& message : m_messages)
+		// kept up to date as messages are added and encoded
+		return m_size;
+	}
+
+	uint32_t DeltaEncode(const uint8_t* data, const uint8_t* reference, uint32_t length, uint8_t* output)
+	{
+		uint32_t maskLength = (length + 7) / 8;
+		uint32_t index = maskLength;
+
+		for (uint32_t i = 0; i < maskLength; i++)
+		{
+			output[i] = 0x00;
+		}
+
+		for (uint32_t i = 0; i < length; i++)
+		{
+			if (data[i] != reference[i])
+			{
+				output[i / 8] |= (uint8_t)(1 << (i % 8));
+				output[index++] = data[i];
+			}
+		}
+		return index;
+	}
+
+	bool DeltaDecode(const uint8_t* encoded, uint32_t encodedLength, const uint8_t* reference, uint32_t length, std::vector<uint8_t>& output)
+	{
+		uint32_t maskLength = (length + 7) / 8;
+		if (encodedLength < maskLength) { return false; }
+
+		uint32_t index = maskLength;
+		output.assign(reference, reference + length);
+		for (uint32_t i = 0; i < length; i++)
 		{
-			size += MessageHeader::Size();
-			size += message->Size();
+			if ((encoded[i / 8] & (1 << (i % 8))) != 0)
+			{
+				if (index >= encodedLength) { return false; }
+				output[i] = encoded[index++];
+			}
 		}
-		return size;
+		return (index == encodedLength);
 	}
 
 
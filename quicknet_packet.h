@@ -22,12 +22,13 @@
 
 //
 // Packet is one or more Messages sent together with one PacketHeader
-// The header contains a checksum for the whole packet and the acks for reliable messages
+// The header contains a checksum for the whole packet, the acks for reliable messages and the timestamps for the RTT
 //
 
 #pragma once
 #include <stdint.h>
 #include <deque>
+#include <vector>
 #include <memory>
 
 namespace quicknet
@@ -36,6 +37,11 @@ namespace quicknet
 	class Stream;
 	class Message;
 
+	// delta encoding for redundant copies: a bitmask of the bytes that differ from the reference, then those bytes
+	// returns the encoded length, output needs room for length + length / 8 + 1 bytes
+	uint32_t DeltaEncode(const uint8_t* data, const uint8_t* reference, uint32_t length, uint8_t* output);
+	bool DeltaDecode(const uint8_t* encoded, uint32_t encodedLength, const uint8_t* reference, uint32_t length, std::vector<uint8_t>& output);
+
 	class PacketHeader
 	{
 	public:
@@ -52,11 +58,15 @@ namespace quicknet
 		void ComputeChecksum(uint8_t* data, uint32_t length);
 
 		// total header size
-		static uint32_t Size() { return (sizeof(uint16_t) * 2) + sizeof(uint32_t); }
+		static uint32_t Size() { return (sizeof(uint16_t) * 4) + sizeof(uint32_t); }
 
 		uint16_t m_checksum;
 		uint16_t m_ackseq;
 		uint32_t m_ackbits;
+		// lower 16 bits of the send time in tenths of a millisecond (0 means none)
+		uint16_t m_timestamp;
+		// the last timestamp received from the remote peer plus how long we held it, so it can get the RTT without the ack delay
+		uint16_t m_echoTimestamp;
 	};
 
 	////////////////////////////////////////////////////////////////////////////////////////
@@ -67,19 +77,34 @@ namespace quicknet
 		Packet();
 		~Packet();
 
-		void GeneratePacketHeader(RemotePeer* peer);
+		// now is the sender time snapshot in microseconds, for the timestamps
+		void GeneratePacketHeader(RemotePeer* peer, uint64_t now);
+		// acking from an older sequence than the newest received one
+		void GeneratePacketHeader(RemotePeer* peer, uint16_t ackSequence, uint64_t now);
 		void GenerateMessageHeaders(RemotePeer* peer);
 		bool AddMessage(std::unique_ptr<Message> message);
-		void BackupReliables(RemotePeer* peer);
+		void BackupReliables(RemotePeer* peer, uint64_t now);
+		// encode redundant messages against the previous one of the same kind when it saves space
+		void EncodeDeltas();
 
 		bool ToBuffer(uint8_t* data, uint32_t length);
 		bool ToStream(Stream& stream);
 
 		uint32_t MessageCount() { return m_messages.size(); }
 		uint32_t Size();
+		// newest sequence inside, known once the message headers are generated (false if there are none)
+		bool NewestSequence(uint16_t& sequence) const { sequence = m_newestSequence; return m_sequenced; }
 
 	private:
+		void trackNewestSequence(uint16_t sequence, RemotePeer* peer);
+
 		PacketHeader m_header;
 		std::deque<std::unique_ptr<Message>> m_messages;
+		// serialized size, header included
+		uint32_t m_size;
+		uint16_t m_newestSequence;
+		bool m_sequenced;
+		// delta encoded payloads matching m_messages (empty when sent as is)
+		std::deque<std::vector<uint8_t>> m_deltas;
 	};
 }
\ No newline at end of file
@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <sstream>
+#include <algorithm>
 #include "quicknet_peer.h"
 #include "quicknet_remotepeer.h"
 #include "quicknet_packet.h"
@@ -42,21 +43,46 @@ namespace quicknet
 	static uint16_t			s_serverPort = 8000;
 	// the broadcast address should be always the same
 	static Address			s_broadcastAddress = Address("255.255.255.255", s_serverPort);
-	static const uint64_t	s_broadcastProbeDelay = 1000;
-	// this should be at least the biggest message size (more with merging on)
-	static const uint16_t	s_bufferSize = 1400;
+	static const uint64_t	s_broadcastProbeDelay = 1000 * 1000;
+	// this should be at least the biggest datagram size, packets grow up to it with path MTU discovery
+	static const uint32_t	s_bufferSize = 64 * 1024;
 
+	// all the times are in microseconds
 	// how much time without receiving reliables/keepalives before dropping
-	static uint64_t s_connectionTimeout = 10 * 1000;
+	static uint64_t s_connectionTimeout = 10 * 1000 * 1000;
 	// how much time should we wait for new acks before sending a KeepAlive
-	static uint64_t s_maxWithoutAcks = 100;
-
-	// max size before we stop adding messages in a packet
-	static const uint16_t s_maximumPacketSize = 1400;
-
-	// how many packets do we send per second at most
-	static uint64_t s_sendRate = 20;
-	static const uint64_t m_sendTime = 1000 / s_sendRate;
+	static uint64_t s_maxWithoutAcks = 100 * 1000;
+	// how much time a received packet can wait for its ack when we have nothing to send back
+	static const uint64_t s_maxAckDelay = 20 * 1000;
+	// acks of their own for sequences older than the ack bits cover, on every pass per peer
+	static const uint32_t s_maxUncoveredAcks = 4;
+
+	// room kept in packets covered by parity, for their group tag and the parity packet overhead
+	static const uint32_t s_fecReservedSize = (MessageHeader::Size() * 2) + MessageFECGroup().Size() + MessageFECParity::FixedSize() + PacketHeader::Size();
+	// packet room taken by a message besides its payload, so it fits even with parity and on a channel
+	static const uint32_t s_messageOverhead = s_fecReservedSize + PacketHeader::Size() + MessageHeader::Size() + MessageHeader::ChannelSize();
+
+	// send rounds per second by default, and the highest tick rate the game can set
+	static const uint32_t s_defaultSendRate = 20;
+	static const uint32_t s_maximumSendRate = 128;
+	// bytes a remote peer gets on every turn of the egress budget, times its weight
+	static const uint32_t s_egressQuantum = 1200;
+	// most send workers a peer can have, and the fewest peers with an open round worth handing to them
+	static const uint32_t s_maximumSendWorkers = 64;
+	static const size_t s_minimumParallelPeers = 8;
+	// game messages the backlog can hold before it ignores the update budget to catch up
+	static const size_t s_maxGameBacklog = 64 * 1024;
+	// slots of the rings between the network thread and the game thread
+	static const uint32_t s_eventRingSize = 4096;
+	// the work posted from other threads is spread over a few rings, so the producers don't all fight for the same head
+	static const uint32_t s_outboundShards = 4;
+	static const uint32_t s_outboundRingSize = 2048;
+
+	// the peer whose network thread this is, if any
+	static thread_local const Peer* t_networkPeer = nullptr;
+	// ring each thread posts to, handed out in turn as the threads show up
+	static std::atomic<uint32_t> s_nextOutboundShard(0);
+	static thread_local uint32_t t_outboundShard = s_nextOutboundShard.fetch_add(1, std::memory_order_relaxed) % s_outboundShards;
 
 	Peer::Peer(bool serverMode, uint8_t maxPeers)
 		: m_maxPeers(maxPeers)
@@ -66,10 +92,43 @@ namespace quicknet
 		, m_peers()
 		, m_addressIDs()
 		, m_lastSend(0)
+		, m_sendTime(1000 * 1000 / s_defaultSendRate)
+		, m_lastSendPass(Utils::GetElapsedMicroseconds())
+		, m_now(m_lastSendPass)
+		, m_egressBudget(0)
+		, m_egressAllowance(0)
+		, m_nextEgressTick(0)
+		, m_egressCursor(0)
+		, m_egressTurnOpen(false)
+		, m_egressStats()
+		, m_sendOrder()
+		, m_sendWorkers()
+		, m_sendBatches()
+		, m_sendTurns()
+		, m_socketBatch()
+		, m_socketBatchSources()
+		, m_updateBudgetTime(0)
+		, m_updateBudgetDatagrams(0)
+		, m_gameBacklog()
+		, m_updateStats()
+		, m_overBudget(false)
+		, m_networkThread()
+		, m_threadRunning(false)
+		, m_threaded(false)
+		, m_sharedState(m_state)
+		, m_events()
+		, m_outbound()
+		, m_eventOverflow()
+		, m_gameUpdateStats()
 		, m_fakePacketLoss(0.0f)
 		, m_fakeLatency()
 		, m_rng((uint32_t)Utils::GetElapsedMilliseconds())
 	{
+		for (uint32_t i = 0; i < s_outboundShards; i++)
+		{
+			m_outbound.emplace_back(new MPSCRing<NetOutbound>(s_outboundRingSize));
+		}
+
 		// bind if its the server to accept incoming connections
 		if (IsServer())
 		{
@@ -80,13 +139,24 @@ namespace quicknet
 
 		// allow broadcast for all peers
 		m_socket.AllowBroadcast(true);
+		// needed for path MTU discovery
+		m_socket.SetDontFragment(true);
 
 		m_recvBuffer = new uint8_t[s_bufferSize];
 		m_sendBuffer = new uint8_t[s_bufferSize];
+		m_fecBuffer = new uint8_t[s_bufferSize];
 	}
 
 	Peer::~Peer()
 	{
+		// the game is going away, so whatever the thread left for it is dropped
+		if (m_threaded)
+		{
+			m_threadRunning.store(false, std::memory_order_release);
+			m_networkThread.join();
+			m_threaded = false;
+		}
+
 		m_socket.Close();
 		if (m_recvBuffer != nullptr)
 		{
@@ -96,6 +166,10 @@ namespace quicknet
 		{
 			delete[] m_sendBuffer;
 		}
+		if (m_fecBuffer != nullptr)
+		{
+			delete[] m_fecBuffer;
+		}
 	}
 
 	bool Peer::FindServers()
@@ -110,7 +184,7 @@ namespace quicknet
 		}
 
 		m_state = NetPeerState::Searching;
-		m_lastSend = Utils::GetElapsedMilliseconds() - 1000;
+		m_lastSend = m_now - s_broadcastProbeDelay;
 
 		return true;
 	}
@@ -122,6 +196,8 @@ namespace quicknet
 		Log::Info(ss.str());
 
 		m_state = NetPeerState::Connecting;
+		// the game may not have updated for a while, the timeouts count from now
+		m_now = Utils::GetElapsedMicroseconds();
 		// add the server peer now
 		AddPeer(address);
 
@@ -139,8 +215,10 @@ namespace quicknet
 			uint8_t assignedID = findFreePeerID();
 			if (assignedID != 0xFF)
 			{
-				RemotePeer* peer = new RemotePeer(address);
+				RemotePeer* peer = new RemotePeer(address, m_now);
 				peer->SetSate(NetPeerState::Connecting);
+				peer->SetCongestionController(std::unique_ptr<CongestionController>(new AIMDController(peer->MaximumPacketSize())));
+				peer->SetSendPhase((assignedID * m_sendTime) / ((uint64_t)m_maxPeers + 1), m_now);
 				// assign an ID for the peer
 				peer->m_assignedID = assignedID;
 				m_peers[assignedID] = peer;
@@ -151,8 +229,9 @@ namespace quicknet
 		}
 		else
 		{
-			RemotePeer* peer = new RemotePeer(address);
+			RemotePeer* peer = new RemotePeer(address, m_now);
 			peer->SetSate(NetPeerState::ServerMode);
+			peer->SetCongestionController(std::unique_ptr<CongestionController>(new AIMDController(peer->MaximumPacketSize())));
 			peer->m_assignedID = 0x00;
 			m_peers[0] = peer;
 			m_addressIDs[address] = 0x00;
@@ -163,6 +242,11 @@ namespace quicknet
 
 	bool Peer::DisconnectPeer(uint8_t peerID, uint8_t amount)
 	{
+		if (onGameThread())
+		{
+			NetOutbound outbound = { NetOutboundType::Disconnect, peerID, amount, nullptr };
+			return postOutbound(outbound);
+		}
 		Log::Info("DisconnectPeer called");
 		if (!peerExists(peerID)) { return false; }
 
@@ -174,14 +258,23 @@ namespace quicknet
 		}
 		// mark it as disconnected to erase it later
 		m_peers[peerID]->SetSate(NetPeerState::Disconnected);
+		// the game is not handed what it still had in the backlog, a new peer could get its ID
+		m_gameBacklog.erase(std::remove_if(m_gameBacklog.begin(), m_gameBacklog.end(),
+			[peerID](const std::pair<uint8_t, std::unique_ptr<Message>>& entry) { return entry.first == peerID; }), m_gameBacklog.end());
 
-		OnDisconnection(peerID);
+		raiseConnection(peerID, false);
 
 		return true;
 	}
 
 	void Peer::DisconnectAll()
 	{
+		if (onGameThread())
+		{
+			NetOutbound outbound = { NetOutboundType::DisconnectAll, 0, 0, nullptr };
+			postOutbound(outbound);
+			return;
+		}
 		Log::Info("DisconnectAll called");
 
 		// this is not very efficient, but its a rarely invoked function
@@ -199,6 +292,28 @@ namespace quicknet
 
 	void Peer::UpdateNetwork()
 	{
+		// the network thread does the rest
+		if (m_threaded)
+		{
+			deliverEvents(m_updateBudgetTime != 0);
+			return;
+		}
+
+		update();
+	}
+
+	void Peer::update()
+	{
+		// the whole pass works with the same time
+		m_now = Utils::GetElapsedMicroseconds();
+		m_updateStats.m_receiveTime = 0;
+		m_updateStats.m_deliverTime = 0;
+		m_updateStats.m_datagrams = 0;
+		m_updateStats.m_gameMessages = 0;
+		m_overBudget = false;
+		// what other threads posted goes before this pass sends
+		takeOutbound();
+
 		switch (m_state)
 		{
 		case NetPeerState::ServerMode:
@@ -207,6 +322,11 @@ namespace quicknet
 			receive();
 			// do maintenance stuff on peers
 			updatePeers();
+			// game messages that waited for the system ones
+			deliverBacklog();
+			// tell the game what got through
+			notifyHandles();
+			notifyTransfers();
 			// send pending messages
 			send();
 		}
@@ -219,7 +339,7 @@ namespace quicknet
 		case NetPeerState::Searching:
 		{
 			// send one probe per second
-			if ((Utils::GetElapsedMilliseconds() - m_lastSend) >= s_broadcastProbeDelay)
+			if ((m_now - m_lastSend) >= s_broadcastProbeDelay)
 			{
 				Log::Info("Sending discovery probe");
 				std::unique_ptr<MessageDiscoveryRequest> message = MessageDiscoveryRequest::Create();
@@ -228,7 +348,7 @@ namespace quicknet
 				{
 					Log::Error("Sending Discovery Message failed");
 				}
-				m_lastSend = Utils::GetElapsedMilliseconds();
+				m_lastSend = m_now;
 			}
 
 			// check if we got some answers
@@ -253,6 +373,11 @@ namespace quicknet
 			receive();
 			// manage connection
 			updatePeers();
+			// game messages that waited for the system ones
+			deliverBacklog();
+			// tell the game what got through
+			notifyHandles();
+			notifyTransfers();
 			// send pending messages
 			send();
 		}
@@ -260,22 +385,92 @@ namespace quicknet
 		default:
 			break;
 		}
+
+		m_updateStats.m_overruns += m_overBudget ? 1 : 0;
 	}
 
-	bool Peer::SendTo(uint8_t peerID, std::unique_ptr<Message> message)
+	bool Peer::SendTo(uint8_t peerID, std::unique_ptr<Message> message, uint32_t ttl)
 	{
+		if (onGameThread())
+		{
+			NetOutbound outbound = { NetOutboundType::Send, peerID, ttl, std::move(message) };
+			return postOutbound(outbound);
+		}
+
 		// this is O(1) because its an unordered map
 		auto peer = m_peers.find(peerID);
 		if (peer != m_peers.end())
 		{
-			return SendTo(peer->second, std::move(message));
+			peer->second->GameActivity(m_now);
+			return SendTo(peer->second, std::move(message), ttl);
 		}
 		return false;
 	}
 
-	bool Peer::SendTo(RemotePeer* peer, std::unique_ptr<Message> message)
+	NetSendResult Peer::TrySendTo(uint8_t peerID, std::unique_ptr<Message>& message, uint32_t ttl)
+	{
+		// the limits of the remote peer are checked on the network thread, here it only blocks on a full ring
+		if (onGameThread())
+		{
+			NetOutbound outbound = { NetOutboundType::Send, peerID, ttl, std::move(message) };
+			if (postOutbound(outbound)) { return NetSendResult::Queued; }
+			message = std::move(outbound.m_message);
+			return NetSendResult::WouldBlock;
+		}
+
+		auto peer = m_peers.find(peerID);
+		if (peer == m_peers.end()) { return NetSendResult::Failed; }
+
+		peer->second->GameActivity(m_now);
+		return sendTo(peer->second, message, ttl);
+	}
+
+	bool Peer::SendTo(RemotePeer* peer, std::unique_ptr<Message> message, uint32_t ttl)
+	{
+		return sendTo(peer, message, ttl) == NetSendResult::Queued;
+	}
+
+	NetSendResult Peer::sendTo(RemotePeer* peer, std::unique_ptr<Message>& message, uint32_t ttl)
 	{
-		if (peer == nullptr) { return false; }
+		if (peer == nullptr || !message) { return NetSendResult::Failed; }
+		bool urgent = message->m_urgent;
+
+		// the pieces have to fit even if the packets shrink back later
+		uint32_t packetSize = peer->FallbackPacketSize();
+		uint32_t pieceSize = packetSize - s_messageOverhead - MessageFragment::FixedSize();
+		bool fragmented = (message->Size() > packetSize - s_messageOverhead);
+		uint32_t count = fragmented ? ((message->Size() + pieceSize - 1) / pieceSize) : 1;
+		uint32_t bytes = fragmented ? (message->Size() + count * (MessageHeader::Size() + MessageHeader::ChannelSize() + MessageFragment::FixedSize())) : message->WireSize();
+
+		// over the limits the message stays with the caller, or the peer goes, but the peer's own messages keep the connection alive
+		MessageHeader header = message->GenerateHeader();
+		bool reliable = flagCheck(peer->ChannelFlags(message->m_channel, header.m_flags), s_flagReliable);
+		if (!header.IsSystem() && !peer->MakeRoom(message.get(), bytes, count, reliable))
+		{
+			if (peer->QueuePolicy() == NetQueuePolicy::Disconnect)
+			{
+				Log::Warn("SendTo: disconnecting a peer over its queue limits");
+				DisconnectPeer(peer->m_assignedID);
+				return NetSendResult::Failed;
+			}
+			return NetSendResult::WouldBlock;
+		}
+
+		// from the update snapshot like the rest of the times (threaded, this runs when the network thread takes it from the ring)
+		if (ttl > 0)
+		{
+			message->m_deadline = m_now + (uint64_t)ttl * 1000;
+		}
+
+		if (fragmented)
+		{
+			bool queued = sendFragmented(peer, std::move(message), pieceSize);
+			if (queued && urgent)
+			{
+				flush(peer);
+			}
+			return queued ? NetSendResult::Queued : NetSendResult::Failed;
+		}
 #if QUICKNET_VERBOSE
 		std::ostringstream ss;
 		ss << "SendTo: Sending message with ID" << message->m_header.m_messageID << " to peer " << peer->m_assignedID;
@@ -283,36 +478,172 @@ namespace quicknet
 #endif
 
 	// add the message for later sending
-		peer->EnqueueMessage(std::move(message));
-		return true;
+		peer->EnqueueMessage(std::move(message), m_now);
+		// urgent ones take whatever else is queued with them
+		if (urgent)
+		{
+			flush(peer);
+		}
+		return NetSendResult::Queued;
 
 		// DEBUG: this is to quick check
 		//bool success = sendMessage(peer->Address(), std::move(message));
 		//return success;
 	}
 
-	bool Peer::SendToAll(std::unique_ptr<Message> message)
+	bool Peer::sendFragmented(RemotePeer* peer, std::unique_ptr<Message> message, uint32_t pieceSize)
+	{
+		MessageHeader header = message->GenerateHeader();
+		header.m_flags = peer->ChannelFlags(message->m_channel, header.m_flags);
+		uint32_t totalSize = message->Size();
+		uint32_t count = (totalSize + pieceSize - 1) / pieceSize;
+		if (count > 0xFFFF)
+		{
+			Log::Warn("SendTo: message is too big even for fragmentation");
+			return false;
+		}
+
+		std::vector<uint8_t> data(totalSize);
+		if (!message->ToBuffer(data.data(), totalSize))
+		{
+			Log::Error("SendTo: serializing a message for fragmentation failed");
+			return false;
+		}
+
+		// spread the size evenly, so the receiver knows where each piece goes from the count
+		pieceSize = (totalSize + count - 1) / count;
+		uint16_t fragmentID = peer->NextFragmentID();
+		if (message->m_handle != 0)
+		{
+			peer->TrackFragmentedHandle(message->m_handle, (uint16_t)count);
+		}
+
+#if QUICKNET_VERBOSE
+		std::ostringstream ss;
+		ss << "SendTo: splitting " << message->Name() << " of " << totalSize << " bytes in " << count << " fragments";
+		Log::Info(ss.str());
+#endif
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t offset = i * pieceSize;
+			uint32_t length = (totalSize - offset < pieceSize) ? (totalSize - offset) : pieceSize;
+
+			std::unique_ptr<MessageFragment> fragment = MessageFragment::Create();
+			fragment->m_fragmentID = fragmentID;
+			fragment->m_index = (uint16_t)i;
+			fragment->m_count = (uint16_t)count;
+			fragment->m_totalSize = totalSize;
+			fragment->m_messageID = header.m_messageID;
+			fragment->m_data.assign(data.begin() + offset, data.begin() + offset + length);
+			fragment->m_reliable = header.IsReliable();
+			fragment->m_deadline = message->m_deadline;
+			fragment->m_handle = message->m_handle;
+			// the pieces keep the channel order, so the whole message is ready in its place
+			fragment->m_channel = message->m_channel;
+			peer->EnqueueMessage(std::move(fragment), m_now);
+		}
+		return true;
+	}
+
+	bool Peer::Flush(uint8_t peerID)
+	{
+		if (onGameThread())
+		{
+			NetOutbound outbound = { NetOutboundType::Flush, peerID, 0, nullptr };
+			return postOutbound(outbound);
+		}
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		flush(it->second);
+		return true;
+	}
+
+	bool Peer::PostTo(uint8_t peerID, std::unique_ptr<Message> message, uint32_t ttl)
+	{
+		NetOutbound outbound = { NetOutboundType::Send, peerID, ttl, std::move(message) };
+		return postOutbound(outbound);
+	}
+
+	bool Peer::PostToAll(std::unique_ptr<Message> message, uint32_t ttl)
 	{
+		NetOutbound outbound = { NetOutboundType::SendToAll, 0, ttl, std::move(message) };
+		return postOutbound(outbound);
+	}
+
+	bool Peer::SendToAll(std::unique_ptr<Message> message, uint32_t ttl)
+	{
+		if (onGameThread())
+		{
+			NetOutbound outbound = { NetOutboundType::SendToAll, 0, ttl, std::move(message) };
+			return postOutbound(outbound);
+		}
+
+		// the copies take the same deadline
+		if (ttl > 0)
+		{
+			message->m_deadline = m_now + (uint64_t)ttl * 1000;
+		}
+
 		// this is not the best way, but a workaround for unique pointers
+		// true only if every remote peer took it
+		bool queued = !m_peers.empty();
 		for (std::pair<const uint8_t, RemotePeer*>& peer : m_peers)
 		{
+			peer.second->GameActivity(m_now);
 			if (m_peers.size() > 1)
 			{
 				message->m_header = message->GenerateHeader();
 				std::unique_ptr<Message> copy = GetMessageFromID((MessageIDs)message->m_header.m_messageID);
 				message->CopyTo(copy.get());
-				SendTo(peer.second, std::move(copy));
+				queued = SendTo(peer.second, std::move(copy)) && queued;
 			}
 			else
 			{
-				SendTo(peer.second, std::move(message));
+				queued = SendTo(peer.second, std::move(message)) && queued;
 			}
 		}
-		return false;
+		return queued;
+	}
+
+	bool Peer::SendFile(uint8_t peerID, const std::string& path, uint16_t& transferID)
+	{
+		std::shared_ptr<BulkFileSource> source = std::make_shared<BulkFileSource>();
+		if (!source->Open(path)) { return false; }
+
+		if (source->FileSize() > 0xFFFFFFFF)
+		{
+			Log::Error("SendFile: " + path + " is too big for a transfer");
+			return false;
+		}
+		return sendBulk(peerID, std::move(source), transferID);
+	}
+
+	bool Peer::SendBlob(uint8_t peerID, std::vector<uint8_t> data, uint16_t& transferID)
+	{
+		if (data.empty() || data.size() > 0xFFFFFFFF) { return false; }
+
+		return sendBulk(peerID, std::make_shared<BulkBlobSource>(std::move(data)), transferID);
 	}
 
-	void Peer::SetServerMode(bool enable)
+	bool Peer::sendBulk(uint8_t peerID, std::shared_ptr<BulkSource> source, uint16_t& transferID)
 	{
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		// chunks are resent as they are, so they have to fit even if the packets shrink back later
+		RemotePeer* peer = it->second;
+		uint16_t chunkSize = (uint16_t)(peer->FallbackPacketSize() - s_messageOverhead - MessageBulkChunk::FixedSize());
+		transferID = peer->GetBulkSender().Add(std::move(source), chunkSize);
+		peer->GameActivity(m_now);
+		return true;
+	}
+
+	bool Peer::SetServerMode(bool enable)
+	{
+		if (onGameThread()) { return false; }
+
 		std::ostringstream ss;
 		ss << "Setting server mode to " << enable;
 		Log::Info(ss.str());
@@ -336,24 +667,208 @@ namespace quicknet
 			Address serverAddr("0.0.0.0", s_serverPort);
 			m_socket.Bind(serverAddr);
 		}
+		return true;
+	}
+
+	bool Peer::SetFEC(uint8_t peerID, bool enable)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetFECEnabled(enable);
+		return true;
+	}
+
+	bool Peer::SetRedundancy(uint8_t peerID, uint8_t copies)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetRedundancy(copies);
+		return true;
+	}
+
+	bool Peer::SetMaximumDatagramSize(uint8_t peerID, uint32_t bytes)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetMaximumDatagramSize(bytes);
+		return true;
+	}
+
+	bool Peer::SetReassemblyLimit(uint8_t peerID, uint32_t bytes)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetReassemblyLimit(bytes);
+		return true;
+	}
+
+	bool Peer::SetSendRate(uint32_t rate)
+	{
+		if (onGameThread()) { return false; }
+
+		rate = (rate == 0) ? 1 : ((rate > s_maximumSendRate) ? s_maximumSendRate : rate);
+		m_sendTime = 1000 * 1000 / rate;
+		return true;
+	}
+
+	bool Peer::SetSendMode(uint8_t peerID, NetSendMode mode, uint32_t window)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetSendMode(mode, window * 1000);
+		return true;
+	}
+
+	bool Peer::SetSendTier(uint8_t peerID, NetSendTier tier)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetSendTier(tier, m_now);
+		return true;
+	}
+
+	bool Peer::SetQueueLimits(uint8_t peerID, uint32_t bytes, uint32_t messages, uint32_t reliables, NetQueuePolicy policy)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetQueueLimits(bytes, messages, reliables, policy);
+		return true;
+	}
+
+	bool Peer::SetEgressBudget(uint32_t bytes)
+	{
+		if (onGameThread()) { return false; }
+
+		m_egressBudget = bytes;
+		return true;
+	}
+
+	bool Peer::SetSendWorkers(uint32_t workers)
+	{
+		if (m_threaded) { return false; }
+
+		workers = (workers > s_maximumSendWorkers) ? s_maximumSendWorkers : workers;
+		m_sendWorkers.reset((workers > 0) ? new WorkerPool(workers) : nullptr);
+
+		// one batch per thread, the updating one included
+		m_sendBatches.clear();
+		m_sendBatches.resize((workers > 0) ? (workers + 1) : 0);
+		for (NetSendBatch& batch : m_sendBatches)
+		{
+			batch.m_buffer.resize(s_bufferSize);
+		}
+		return true;
+	}
+
+	bool Peer::SetEgressWeight(uint8_t peerID, uint16_t weight)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetEgressWeight(weight);
+		return true;
+	}
+
+	bool Peer::SetChannel(uint8_t peerID, uint8_t channel, NetChannelMode mode, uint8_t priority, uint16_t weight)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetChannel(channel, mode, priority, weight);
+		return true;
+	}
+
+	bool Peer::SetBulkShare(uint8_t peerID, uint8_t percent)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetBulkShare(percent);
+		return true;
+	}
+
+	bool Peer::SetSendBudget(uint8_t peerID, uint32_t bytes)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetSendBudget(bytes);
+		return true;
+	}
+
+	bool Peer::SetCongestionController(uint8_t peerID, std::unique_ptr<CongestionController> controller)
+	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetCongestionController(std::move(controller));
+		return true;
 	}
 
-	void Peer::SetFakePacketLoss(float percentage)
+	bool Peer::SetAckFrequency(uint8_t peerID, uint8_t packets)
 	{
+		if (onGameThread()) { return false; }
+
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		it->second->SetAckFrequency(packets);
+		return true;
+	}
+
+	bool Peer::SetFakePacketLoss(float percentage)
+	{
+		if (onGameThread()) { return false; }
+
 		m_fakePacketLoss = ((percentage < 0.0f) ? 0.0f : (percentage > 1.0f ? 1.0f : percentage));
 
 		std::ostringstream ss;
 		ss << "Fake Packet Loss set to: " << m_fakePacketLoss;
 		Log::Info(ss.str());
+		return true;
 	}
 
-	void Peer::SetFakeLatency(uint32_t milliseconds)
+	bool Peer::SetFakeLatency(uint32_t milliseconds)
 	{
+		if (onGameThread()) { return false; }
+
 		m_fakeLatency.SetLatency(milliseconds);
 
 		std::ostringstream ss;
 		ss << "Fake latency set to " << milliseconds << "ms";
 		Log::Info(ss.str());
+		return true;
 	}
 
 	const uint32_t Peer::RTT()
@@ -362,7 +877,7 @@ namespace quicknet
 		{
 			if (!IsServer())
 			{
-				return m_peers[0]->RTT();
+				return m_peers[0]->RTT() / 1000;
 			}
 			else
 			{
@@ -372,12 +887,49 @@ namespace quicknet
 					avg += peerPair.second->RTT();
 				}
 				avg /= m_peers.size();
-				return avg;
+				return avg / 1000;
 			}
 		}
 		return 0;
 	}
 
+	bool Peer::GetPeerStats(uint8_t peerID, NetPeerStats& stats)
+	{
+		auto it = m_peers.find(peerID);
+		if (it == m_peers.end()) { return false; }
+
+		RemotePeer* peer = it->second;
+		stats.m_rtt = peer->RTT();
+		stats.m_rttVariance = peer->RTTVariance();
+		stats.m_rto = peer->RTO();
+		stats.m_resends = peer->ResendCount();
+		stats.m_fastResends = peer->FastResendCount();
+		stats.m_packetLoss = peer->PacketLoss();
+		stats.m_fecGroupSize = peer->IsFECEnabled() ? peer->FECGroupSize() : 0;
+		stats.m_fecRecovered = peer->GetFECDecoder().Recovered();
+		stats.m_deadlineDrops = peer->DeadlineDropCount();
+		stats.m_minRTT = peer->MinRTT();
+		stats.m_pacingRate = peer->PacingRate(m_sendTime);
+		stats.m_datagramSize = peer->MaximumPacketSize();
+		stats.m_reassemblyBytes = peer->ReassemblyBytes();
+		stats.m_roundDivisor = peer->RoundDivisor();
+		stats.m_queuedBytes = peer->PendingBytes();
+		stats.m_queuedMessages = peer->PendingCount();
+		stats.m_reliablesInFlight = peer->ReliablesInFlight();
+		stats.m_heldBytes = peer->HeldBytes();
+		stats.m_queueDrops = peer->QueueDropCount();
+		stats.m_queueRejects = peer->QueueRejectCount();
+		stats.m_superseded = peer->SupersededCount();
+		stats.m_bytesSent = peer->BytesSent();
+		stats.m_bytesReceived = peer->BytesReceived();
+		stats.m_packetsSent = peer->PacketsSent();
+		stats.m_packetsReceived = peer->PacketsReceived();
+		stats.m_bytesInFlight = peer->BytesInFlight();
+		stats.m_congestionWindow = peer->GetCongestionController() ? peer->GetCongestionController()->CongestionWindow() : 0;
+		stats.m_bandwidth = peer->GetCongestionController() ? peer->GetCongestionController()->Bandwidth() : 0;
+		return true;
+	}
+
 	uint8_t Peer::findFreePeerID()
 	{
 		// 0 is the server
@@ -405,7 +957,7 @@ namespace quicknet
 			std::unique_ptr<Message> message = nullptr;
 			Address address;
 
-			m_fakeLatency.GetMessageReady(message, address);
+			m_fakeLatency.GetMessageReady(message, address, m_now);
 			while (message)
 			{
 #if QUICKNET_VERBOSE
@@ -416,16 +968,16 @@ namespace quicknet
 				RemotePeer* peer = addressToPeer(address);
 				if (peer == nullptr)
 				{
-					RemotePeer unk(address);
-					processMessage(message.get(), &unk);
+					RemotePeer unk(address, m_now);
+					dispatchMessage(std::move(message), &unk);
 				}
 				else
 				{
-					processMessage(message.get(), peer);
+					deliverMessage(std::move(message), peer);
 				}
 
 				// get another until we run out of them
-				m_fakeLatency.GetMessageReady(message, address);
+				m_fakeLatency.GetMessageReady(message, address, m_now);
 			}
 		}
 
@@ -437,7 +989,7 @@ namespace quicknet
 			RemotePeer* peer = peerPair.second;
 
 			// if we dont get any message in a long time, disconnect
-			if (peer->MillisecondsSinceLastMessage() > s_connectionTimeout)
+			if (peer->MicrosecondsSinceLastMessage(m_now) > s_connectionTimeout)
 			{
 				DisconnectPeer(peer->m_assignedID);
 			}
@@ -454,19 +1006,23 @@ namespace quicknet
 				continue;
 			}
 
+			// free the fragmented messages and transfers that will never be complete
+			peer->DropStaleFragments(m_now);
+			peer->GetBulkReceiver().DropStale(m_now);
+
 			// if we got no acks in s_maxWithoutAck seconds
-			if (peer->MillisecondsSinceLastAck() > s_maxWithoutAcks)
+			if (peer->MicrosecondsSinceLastAck(m_now) > s_maxWithoutAcks)
 			{
 #if QUICKNET_VERBOSE
 				Log::Info("Sending KeepAlive because connection inactivity");
 #endif
 				// send an unreliable keepAlive (which will be returned, hopefully)
 				std::unique_ptr<MessageKeepAlive> keepAlive = MessageKeepAlive::Create();
-				keepAlive->m_timeStamp = Utils::GetElapsedMilliseconds();
+				keepAlive->m_timeStamp = m_now;
 				keepAlive->m_serverSent = IsServer() ? 0x01 : 0x00;
 				SendTo(peer, std::move(keepAlive));
 				// we will send another in s_maxWithoutAcks if we still get nothing
-				peer->UpdateLastAckTime();
+				peer->UpdateLastAckTime(m_now);
 			}
 		}
 
@@ -476,6 +1032,11 @@ namespace quicknet
 			for (const uint8_t peerID : toRemove)
 			{
 				RemotePeer* peer = m_peers[peerID];
+
+				// the game gets a final answer for everything it was still waiting on
+				peer->LoseHandles();
+				notifyHandles(peerID, peer);
+
 				m_addressIDs.erase(peer->Address());
 				m_peers.erase(peerID);
 				delete peer;
@@ -497,10 +1058,18 @@ namespace quicknet
 
 			do
 			{
+				// with a budget the rest waits in the socket for the next update
+				if (isOverBudget(m_updateStats.m_datagrams))
+				{
+					m_overBudget = true;
+					break;
+				}
+
 				read = 0;
 				success = m_socket.Recv(m_recvBuffer, s_bufferSize, &read, remote);
 				if (success && read > 0)
 				{
+					m_updateStats.m_datagrams++;
 					// if packet loss is active, discard the buffer directly
 					if ((m_fakePacketLoss > 0.0f) && (m_rng.GetFloat() <= m_fakePacketLoss))
 					{
@@ -518,9 +1087,9 @@ namespace quicknet
 						Log::Info(ss.str());
 #endif
 						// if we have no entry, create a temporary one
-						RemotePeer unknownPeer(remote);
+						RemotePeer unknownPeer(remote, m_now);
 						// parse the packets inside the buffer
-						parseBuffer(read, &unknownPeer);
+						parseBuffer(m_recvBuffer, read, &unknownPeer);
 					}
 					else
 					{
@@ -530,48 +1099,389 @@ namespace quicknet
 						Log::Info(ss.str());
 #endif
 						// parse the packets inside the buffer
-						parseBuffer(read, peer);
+						peer->CountReceived(read);
+						parseBuffer(m_recvBuffer, read, peer);
 					}
 				}
 			} while (success && read > 0);
 		}
+		m_updateStats.m_receiveTime = (uint32_t)(Utils::GetElapsedMicroseconds() - m_now);
 	}
 
-	void Peer::parseBuffer(uint32_t length, RemotePeer* peer)
+	bool Peer::isOverBudget(uint32_t datagrams) const
 	{
-		if (length < PacketHeader::Size())
+		// the network thread has no frame to keep, the budget is for the game thread then
+		if (m_threaded) { return false; }
+		if (m_updateBudgetDatagrams != 0 && datagrams >= m_updateBudgetDatagrams) { return true; }
+		return (m_updateBudgetTime != 0) && (Utils::GetElapsedMicroseconds() - m_now >= m_updateBudgetTime);
+	}
+
+	bool Peer::SetUpdateBudget(uint32_t microseconds, uint32_t datagrams)
+	{
+		if (onGameThread()) { return false; }
+
+		m_updateBudgetTime = microseconds;
+		m_updateBudgetDatagrams = datagrams;
+		return true;
+	}
+
+	void Peer::deliverBacklog()
+	{
+		if (m_gameBacklog.empty())
 		{
-			Log::Warn("Received data is smaller than packet header size");
+			m_updateStats.m_backlog = 0;
 			return;
 		}
 
-		Stream stream(m_recvBuffer, length, NetStreamMode::Read);
+		uint64_t start = Utils::GetElapsedMicroseconds();
+		uint32_t delivered = 0;
+		while (!m_gameBacklog.empty())
+		{
+			// at least one goes on every update, and a backlog too deep catches up regardless
+			if (delivered > 0 && m_gameBacklog.size() <= s_maxGameBacklog && m_updateBudgetTime != 0 &&
+				(Utils::GetElapsedMicroseconds() - m_now >= m_updateBudgetTime))
+			{
+				m_overBudget = true;
+				break;
+			}
 
-		// read the packet header first
-		PacketHeader packetHeader;
-		packetHeader.FromStream(stream);
+			std::pair<uint8_t, std::unique_ptr<Message>> entry = std::move(m_gameBacklog.front());
+			m_gameBacklog.pop_front();
+			// the ones from peers that are gone are dropped
+			auto it = m_peers.find(entry.first);
+			if (it == m_peers.end() || it->second->State() == NetPeerState::Disconnected) { continue; }
 
-		// discard the whole packet now if its wrong to save time
-		if (!packetHeader.IsChecksumValid(m_recvBuffer, length))
-		{
-			Log::Warn("Packet checksum is invalid. Discarding...");
-			return;
+			processMessage(entry.second.get(), it->second);
+			delivered++;
 		}
 
-		// check acknowledgments here
-		processAcks(peer, packetHeader);
+		m_updateStats.m_gameMessages += delivered;
+		m_updateStats.m_backlog = (uint32_t)m_gameBacklog.size();
+		m_updateStats.m_deliverTime = (uint32_t)(Utils::GetElapsedMicroseconds() - start);
+	}
 
-		// cycle through all the messages contained in this packet
-		while (!stream.Full())
-		{
-			// read message header first, this way we can skip the message earlier
-			MessageHeader header;
-			header.FromStream(stream);
+	bool Peer::StartNetworkThread(uint32_t interval)
+	{
+		if (m_threaded) { return false; }
+
+		m_events.reset(new SPSCRing<NetEvent>(s_eventRingSize));
+		m_gameUpdateStats = NetUpdateStats();
+		m_sharedState.store(m_state, std::memory_order_release);
+		m_threaded = true;
+		m_threadRunning.store(true, std::memory_order_release);
+		m_networkThread = std::thread(&Peer::networkThread, this, interval);
+		return true;
+	}
 
-			// check sequence and discard if necessary
-			if (peer->State() != NetPeerState::Disconnected && !header.IsUnsequenced())
-			{
-				// if sequence is newer, update it
+	void Peer::StopNetworkThread()
+	{
+		if (!m_threaded) { return; }
+
+		m_threadRunning.store(false, std::memory_order_release);
+		m_networkThread.join();
+		m_threaded = false;
+
+		// from here on its all on this thread again, so the work left on both sides is done right away
+		deliverEvents(false);
+		for (NetEvent& event : m_eventOverflow)
+		{
+			dispatchEvent(event);
+		}
+		m_eventOverflow.clear();
+		takeOutbound();
+	}
+
+	void Peer::networkThread(uint32_t interval)
+	{
+		t_networkPeer = this;
+		while (m_threadRunning.load(std::memory_order_acquire))
+		{
+			// what the game thread couldn't take before goes first, to keep the order
+			while (!m_eventOverflow.empty() && m_events->TryPush(m_eventOverflow.front()))
+			{
+				m_eventOverflow.pop_front();
+			}
+
+			update();
+			m_sharedState.store(m_state, std::memory_order_release);
+			Utils::SleepMicroseconds(interval);
+		}
+		t_networkPeer = nullptr;
+	}
+
+	bool Peer::onGameThread() const
+	{
+		return m_threaded && (t_networkPeer != this);
+	}
+
+	bool Peer::postOutbound(NetOutbound& outbound)
+	{
+		return m_outbound[t_outboundShard]->TryPush(outbound);
+	}
+
+	void Peer::takeOutbound()
+	{
+		NetOutbound outbound;
+		for (std::unique_ptr<MPSCRing<NetOutbound>>& shard : m_outbound)
+		{
+			while (shard->TryPop(outbound))
+			{
+				takeOutbound(outbound);
+			}
+		}
+	}
+
+	void Peer::takeOutbound(NetOutbound& outbound)
+	{
+		switch (outbound.m_type)
+		{
+		case NetOutboundType::Send:
+			SendTo(outbound.m_peerID, std::move(outbound.m_message), outbound.m_ttl);
+			break;
+		case NetOutboundType::SendToAll:
+			SendToAll(std::move(outbound.m_message), outbound.m_ttl);
+			break;
+		case NetOutboundType::Flush:
+			Flush(outbound.m_peerID);
+			break;
+		case NetOutboundType::Disconnect:
+			DisconnectPeer(outbound.m_peerID, (uint8_t)outbound.m_ttl);
+			break;
+		case NetOutboundType::DisconnectAll:
+			DisconnectAll();
+			break;
+		default:
+			break;
+		}
+	}
+
+	void Peer::raise(NetEvent& event)
+	{
+		// the game thread is behind, the overflow keeps them in order until the ring has room
+		if (!m_eventOverflow.empty() || !m_events->TryPush(event))
+		{
+			m_eventOverflow.push_back(std::move(event));
+		}
+	}
+
+	void Peer::raiseConnection(uint8_t peerID, bool connected)
+	{
+		if (!m_threaded)
+		{
+			if (connected) { OnConnection(peerID); }
+			else { OnDisconnection(peerID); }
+			return;
+		}
+
+		NetEvent event;
+		event.m_type = connected ? NetEventType::Connection : NetEventType::Disconnection;
+		event.m_peerID = peerID;
+		raise(event);
+	}
+
+	void Peer::raiseHandles(uint8_t peerID, const std::vector<uint32_t>& handles, bool delivered)
+	{
+		if (!m_threaded)
+		{
+			if (delivered) { OnDelivered(peerID, handles); }
+			else { OnLost(peerID, handles); }
+			return;
+		}
+
+		NetEvent event;
+		event.m_type = delivered ? NetEventType::Delivered : NetEventType::Lost;
+		event.m_peerID = peerID;
+		event.m_handles = handles;
+		raise(event);
+	}
+
+	void Peer::raiseTransfer(NetEventType type, uint8_t peerID, uint16_t transferID, uint32_t bytes, uint32_t total)
+	{
+		if (!m_threaded)
+		{
+			if (type == NetEventType::TransferProgress) { OnTransferProgress(peerID, transferID, bytes, total); }
+			else { OnTransferIncoming(peerID, transferID, bytes, total); }
+			return;
+		}
+
+		NetEvent event;
+		event.m_type = type;
+		event.m_peerID = peerID;
+		event.m_transferID = transferID;
+		event.m_bytes = bytes;
+		event.m_total = total;
+		raise(event);
+	}
+
+	void Peer::raiseTransferReceived(uint8_t peerID, uint16_t transferID, std::vector<uint8_t>& data)
+	{
+		if (!m_threaded)
+		{
+			OnTransferReceived(peerID, transferID, data);
+			return;
+		}
+
+		// the data is taken instead of copied, it's filled again for the next one anyway
+		NetEvent event;
+		event.m_type = NetEventType::TransferReceived;
+		event.m_peerID = peerID;
+		event.m_transferID = transferID;
+		event.m_data = std::move(data);
+		raise(event);
+	}
+
+	void Peer::raiseEgressTick(const NetEgressStats& stats)
+	{
+		if (!m_threaded)
+		{
+			OnEgressTick(stats);
+			return;
+		}
+
+		NetEvent event;
+		event.m_type = NetEventType::EgressTick;
+		event.m_egress = stats;
+		raise(event);
+	}
+
+	void Peer::deliverEvents(bool budgeted)
+	{
+		uint64_t start = Utils::GetElapsedMicroseconds();
+		uint32_t delivered = 0;
+		bool overBudget = false;
+
+		NetEvent event;
+		while (true)
+		{
+			// at least one goes on every update
+			if (budgeted && delivered > 0 && (Utils::GetElapsedMicroseconds() - start >= m_updateBudgetTime))
+			{
+				overBudget = true;
+				break;
+			}
+			if (!m_events->TryPop(event)) { break; }
+
+			dispatchEvent(event);
+			delivered += (event.m_type == NetEventType::GameMessage) ? 1 : 0;
+			event.m_message.reset();
+		}
+
+		m_gameUpdateStats.m_gameMessages = delivered;
+		m_gameUpdateStats.m_backlog = m_events->Size();
+		m_gameUpdateStats.m_deliverTime = (uint32_t)(Utils::GetElapsedMicroseconds() - start);
+		m_gameUpdateStats.m_overruns += overBudget ? 1 : 0;
+	}
+
+	void Peer::dispatchEvent(NetEvent& event)
+	{
+		switch (event.m_type)
+		{
+		case NetEventType::Connection:
+			OnConnection(event.m_peerID);
+			break;
+		case NetEventType::Disconnection:
+			OnDisconnection(event.m_peerID);
+			break;
+		case NetEventType::GameMessage:
+			OnGameMessage(event.m_message.get());
+			break;
+		case NetEventType::Delivered:
+			OnDelivered(event.m_peerID, event.m_handles);
+			break;
+		case NetEventType::Lost:
+			OnLost(event.m_peerID, event.m_handles);
+			break;
+		case NetEventType::TransferProgress:
+			OnTransferProgress(event.m_peerID, event.m_transferID, event.m_bytes, event.m_total);
+			break;
+		case NetEventType::TransferIncoming:
+			OnTransferIncoming(event.m_peerID, event.m_transferID, event.m_bytes, event.m_total);
+			break;
+		case NetEventType::TransferReceived:
+			OnTransferReceived(event.m_peerID, event.m_transferID, event.m_data);
+			break;
+		case NetEventType::EgressTick:
+			OnEgressTick(event.m_egress);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void Peer::parseBuffer(uint8_t* buffer, uint32_t length, RemotePeer* peer)
+	{
+		if (length < PacketHeader::Size())
+		{
+			Log::Warn("Received data is smaller than packet header size");
+			return;
+		}
+
+		Stream stream(buffer, length, NetStreamMode::Read);
+
+		// read the packet header first
+		PacketHeader packetHeader;
+		packetHeader.FromStream(stream);
+
+		// discard the whole packet now if its wrong to save time
+		if (!packetHeader.IsChecksumValid(buffer, length))
+		{
+			Log::Warn("Packet checksum is invalid. Discarding...");
+			return;
+		}
+
+		// check acknowledgments here
+		processAcks(peer, packetHeader);
+
+		// rebuilt packets arrive late, their times would spoil the RTT
+		if (buffer != m_fecBuffer)
+		{
+			peer->ProcessTimestamps(packetHeader.m_timestamp, packetHeader.m_echoTimestamp, m_now);
+		}
+
+		// last payload of each redundant message kind, delta encoded copies are built from them
+		std::unordered_map<uint8_t, std::vector<uint8_t>> references;
+		// whether the remote peer is waiting for an ack of this packet
+		bool ackable = false;
+
+		// cycle through all the messages contained in this packet
+		while (!stream.Full())
+		{
+			// read message header first, this way we can skip the message earlier
+			MessageHeader header;
+			header.FromStream(stream);
+
+			// redundant payloads are needed as reference even if the message itself is discarded
+			std::vector<uint8_t> decoded;
+			if (header.IsRedundant())
+			{
+				uint32_t available = (header.m_size > stream.Remaining()) ? stream.Remaining() : header.m_size;
+				const uint8_t* payload = buffer + stream.Position();
+				std::vector<uint8_t>& reference = references[header.m_messageID];
+
+				if (header.IsDelta())
+				{
+					if (reference.empty() || !DeltaDecode(payload, available, reference.data(), (uint32_t)reference.size(), decoded))
+					{
+						Log::Warn("Delta encoded message has no valid reference. Skipping");
+						stream.Skip(header.m_size);
+						continue;
+					}
+					reference = decoded;
+				}
+				else
+				{
+					reference.assign(payload, payload + available);
+				}
+			}
+
+			// check sequence and discard if necessary
+			if (peer->State() != NetPeerState::Disconnected && !header.IsUnsequenced())
+			{
+				// even duplicated ones, their ack was probably lost
+				ackable = true;
+				peer->AckableSequenceReceived(header.m_sequence);
+
+				// if sequence is newer, update it
 				if (peer->IsSequenceNewer(header.m_sequence, peer->CurrentSequenceIn()))
 				{
 #if QUICKNET_VERBOSE
@@ -590,8 +1500,8 @@ namespace quicknet
 					ss << "Received sequence is older (" << header.m_sequence << " vs " << peer->CurrentSequenceIn() << ")";
 					Log::Info(ss.str());
 #endif
-					// check flags so we dont discard the important ones
-					if (header.IsOrdered() && !header.IsReliable())
+					// check flags so we dont discard the important ones (channels keep their own order)
+					if (header.IsOrdered() && !header.IsReliable() && !header.IsChanneled())
 					{
 #if QUICKNET_VERBOSE
 						Log::Info("Skipping message because old sequence");
@@ -620,23 +1530,59 @@ namespace quicknet
 			std::unique_ptr<Message> message = GetMessageFromID((MessageIDs)header.m_messageID);
 			if (message)
 			{
-				bool success = message->FromStream(stream);
+				bool success;
+				bool delta = header.IsDelta();
+				if (delta)
+				{
+					Stream deltaStream(decoded.data(), (uint32_t)decoded.size(), NetStreamMode::Read);
+					success = message->FromStream(deltaStream);
+					stream.Skip(header.m_size);
+
+					// from here on its just a regular message
+					header.m_flags &= ~s_flagDelta;
+					header.m_size = message->Size();
+				}
+				else
+				{
+					success = message->FromStream(stream);
+				}
+
 				if (success)
 				{
 					message->m_header = header;
 
+					// forward error correction works on whole packets, so handle it here
+					if (header.m_messageID == MessageIDs::FECGroup)
+					{
+						if (peer->State() != NetPeerState::Disconnected)
+						{
+							MessageFECGroup* group = (MessageFECGroup*)message.get();
+							peer->GetFECDecoder().AddPacket(group->m_group, group->m_index, group->m_count, buffer, length);
+						}
+						continue;
+					}
+					if (header.m_messageID == MessageIDs::FECParity)
+					{
+						// rebuilt packets carry no parity, so this can't recurse further
+						if (peer->State() != NetPeerState::Disconnected && buffer != m_fecBuffer)
+						{
+							recoverFECPacket(peer, (MessageFECParity*)message.get());
+						}
+						continue;
+					}
+
 					// keep the message waiting if we have fake latency
 					if (m_fakeLatency.CurrentLatency() > 0)
 					{
 #if QUICKNET_VERBOSE
 						Log::Info("Fake Latency active: saving message for later");
 #endif
-						m_fakeLatency.AddPendingMessage(std::move(message), peer);
+						m_fakeLatency.AddPendingMessage(std::move(message), peer, m_now);
 					}
 					else
 					{
 						// do the actual processing
-						processMessage(message.get(), peer);
+						deliverMessage(std::move(message), peer);
 
 						// unknown peers should send 1 message per packet
 						// known peers that just disconnected need no further processing
@@ -649,7 +1595,10 @@ namespace quicknet
 				else
 				{
 					Log::Warn("Message failed to deserialize. Skipping");
-					stream.Skip(header.m_size);
+					if (!delta)
+					{
+						stream.Skip(header.m_size);
+					}
 					continue;
 				}
 			}
@@ -662,12 +1611,72 @@ namespace quicknet
 				continue;
 			}
 		}
+
+		if (ackable)
+		{
+			peer->AckablePacketReceived(m_now);
+		}
+	}
+
+	void Peer::recoverFECPacket(RemotePeer* peer, const MessageFECParity* parity)
+	{
+		uint32_t length = peer->GetFECDecoder().Recover(parity->m_group, parity->m_count, parity->m_lengthXor, parity->m_parity, m_fecBuffer, s_bufferSize);
+		if (length == 0) { return; }
+
+#if QUICKNET_VERBOSE
+		std::ostringstream ss;
+		ss << "FEC: rebuilt a lost packet of group " << parity->m_group << " (" << length << " bytes)";
+		Log::Info(ss.str());
+#endif
+		parseBuffer(m_fecBuffer, length, peer);
+	}
+
+	void Peer::deliverMessage(std::unique_ptr<Message> message, RemotePeer* peer)
+	{
+		if (!message->m_header.IsChanneled() || peer->State() == NetPeerState::Disconnected)
+		{
+			dispatchMessage(std::move(message), peer);
+			return;
+		}
+
+		peer->ReceiveOnChannel(std::move(message), m_channelReady);
+		for (std::unique_ptr<Message>& ready : m_channelReady)
+		{
+			dispatchMessage(std::move(ready), peer);
+		}
+		m_channelReady.clear();
+	}
+
+	void Peer::dispatchMessage(std::unique_ptr<Message> message, RemotePeer* peer)
+	{
+		// unknown peers only send system messages that matter, and they are not in the peer list
+		if (m_threaded && !message->m_header.IsSystem())
+		{
+			peer->UpdateLastMessageTime(m_now);
+			NetEvent event;
+			event.m_type = NetEventType::GameMessage;
+			event.m_peerID = peer->m_assignedID;
+			event.m_message = std::move(message);
+			raise(event);
+			return;
+		}
+
+		bool budgeted = (m_updateBudgetTime != 0 || m_updateBudgetDatagrams != 0);
+		if (message->m_header.IsSystem() || peer->State() == NetPeerState::Disconnected || (!budgeted && m_gameBacklog.empty()))
+		{
+			processMessage(message.get(), peer);
+			return;
+		}
+
+		// it still counts as heard from the peer now
+		peer->UpdateLastMessageTime(m_now);
+		m_gameBacklog.emplace_back(peer->m_assignedID, std::move(message));
 	}
 
 	void Peer::processMessage(const Message* const message, RemotePeer* peer)
 	{
 		// we got a new message, so update the connection timeout
-		peer->UpdateLastMessageTime();
+		peer->UpdateLastMessageTime(m_now);
 
 		// process the message here if its a management message
 		// if not, pass it to the callback
@@ -798,7 +1807,7 @@ namespace quicknet
 							SendTo(peer, std::move(answer));
 							// finally mark it as connected
 							peer->SetSate(NetPeerState::Connected);
-							OnConnection(peer->m_assignedID);
+							raiseConnection(peer->m_assignedID, true);
 						}
 						else
 						{
@@ -855,7 +1864,7 @@ namespace quicknet
 					Log::Warn("Client received a ConnectionSuccess message. We are connected!");
 					// mark us as connected
 					m_state = NetPeerState::Connected;
-					OnConnection(m_assignedID);
+					raiseConnection(m_assignedID, true);
 				}
 			}
 			break;
@@ -874,8 +1883,8 @@ namespace quicknet
 #endif
 				if (serverSent || clientSent)
 				{
-					uint64_t milliseconds = Utils::GetElapsedMilliseconds() - keepAlive->m_timeStamp;
-					peer->UpdateRTT((uint32_t)milliseconds);
+					uint64_t microseconds = m_now - keepAlive->m_timeStamp;
+					peer->UpdateRTT((uint32_t)microseconds, m_now);
 				}
 				else
 				{
@@ -888,6 +1897,33 @@ namespace quicknet
 
 			}
 			break;
+			case MTUProbe:
+			{
+				// only its ack matters, and thats handled with the sequences
+			}
+			break;
+			case BulkChunk:
+			{
+				// unknown peers are temporary, they can't keep transfers around
+				if (peer->State() != NetPeerState::Disconnected)
+				{
+					peer->GetBulkReceiver().AddChunk((MessageBulkChunk*)message, m_now);
+				}
+			}
+			break;
+			case Fragment:
+			{
+				// unknown peers are temporary, they can't keep pieces around
+				if (peer->State() != NetPeerState::Disconnected)
+				{
+					std::unique_ptr<Message> whole = peer->AddFragment((MessageFragment*)message, m_now);
+					if (whole)
+					{
+						dispatchMessage(std::move(whole), peer);
+					}
+				}
+			}
+			break;
 			case DisconnectionRequest:
 			{
 				if (IsServer())
@@ -895,7 +1931,7 @@ namespace quicknet
 					if (peer->State() != NetPeerState::Disconnected)
 					{
 						// client quits
-						OnDisconnection(peer->m_assignedID);
+						raiseConnection(peer->m_assignedID, false);
 						DisconnectPeer(peer->m_assignedID, 0);
 					}
 					else
@@ -906,7 +1942,7 @@ namespace quicknet
 				else
 				{
 					// server disconnects client (me)
-					OnDisconnection(m_assignedID);
+					raiseConnection(m_assignedID, false);
 					DisconnectAll();
 				}
 			}
@@ -934,89 +1970,679 @@ namespace quicknet
 		ss << "ACKS: sequence is " << header.m_ackseq << ". bits: " << header.m_ackbits;
 		Log::Info(ss.str());
 #endif
-		peer->ProcessAckBits(header.m_ackseq, header.m_ackbits);
+		peer->ProcessAckBits(header.m_ackseq, header.m_ackbits, m_now);
 	}
 
-	void Peer::send()
+	void Peer::notifyHandles()
 	{
 		for (std::pair<const uint8_t, RemotePeer*>& peer : m_peers)
 		{
-			// check if its too early to send another packet
-			if (peer.second->MillisecondsSinceLastSend() < m_sendTime)
-			{
-				continue;
-			}
+			notifyHandles(peer.first, peer.second);
+		}
+	}
 
-#if QUICKNET_VERBOSE
-			//std::ostringstream ss;
-			//ss << "elapsed " << peer.second->TicksSinceLastSend() << " of " << m_sendTime;
-			//Log::Info(ss.str());
-#endif
+	void Peer::notifyHandles(uint8_t peerID, RemotePeer* peer)
+	{
+		if (!peer->TakeHandleNotifications(m_deliveredHandles, m_lostHandles)) { return; }
 
-		// if we have something to send for this peer
-			if (peer.second->HaveMessagesPending())
-			{
-				Packet packet;
+		if (!m_deliveredHandles.empty())
+		{
+			raiseHandles(peerID, m_deliveredHandles, true);
+		}
+		if (!m_lostHandles.empty())
+		{
+			raiseHandles(peerID, m_lostHandles, false);
+		}
+	}
 
-				// first put the oldest ack-pending reliable
-				packet.AddMessage(peer.second->DequeueReliableMessage());
+	void Peer::notifyTransfers()
+	{
+		for (std::pair<const uint8_t, RemotePeer*>& peer : m_peers)
+		{
+			if (peer.second->GetBulkSender().TakeProgress(m_transferProgress))
+			{
+				for (const BulkTransferProgress& progress : m_transferProgress)
+				{
+					raiseTransfer(NetEventType::TransferProgress, peer.first, progress.m_transferID, progress.m_bytes, progress.m_total);
+				}
+			}
 
-				// if we have room for more messages
-				while (packet.Size() < s_maximumPacketSize)
+			BulkReceiver& receiver = peer.second->GetBulkReceiver();
+			if (receiver.TakeProgress(m_transferProgress))
+			{
+				for (const BulkTransferProgress& progress : m_transferProgress)
 				{
-					// try to add a pending message
-					bool added = packet.AddMessage(peer.second->DequeueMessage());
-					if (!added) { break; }
+					raiseTransfer(NetEventType::TransferIncoming, peer.first, progress.m_transferID, progress.m_bytes, progress.m_total);
 				}
+			}
 
-				// if theres no messages, go to next peer
-				if (packet.MessageCount() == 0) { continue; }
+			uint16_t transferID;
+			while (receiver.TakeCompleted(transferID, m_transferData))
+			{
+				raiseTransferReceived(peer.first, transferID, m_transferData);
+			}
+		}
+	}
 
-				// generate the headers for both packet and messages
-				packet.GeneratePacketHeader(peer.second);
-				packet.GenerateMessageHeaders(peer.second);
+	void Peer::send()
+	{
+		uint64_t now = m_now;
 
-#if QUICKNET_VERBOSE
-				std::ostringstream ss;
-				ss << "Sending packet with " << packet.MessageCount() << " messages inside";
-				Log::Info(ss.str());
-#endif
+		// the egress budget comes back on every send tick
+		if (now >= m_nextEgressTick)
+		{
+			closeEgressTick(now);
+		}
+
+		// every peer starts its rounds at the send rate, each one with its own phase
+		m_sendOrder.clear();
+		for (std::pair<const uint8_t, RemotePeer*>& peer : m_peers)
+		{
+			peer.second->UpdateSendRound(now, m_sendTime);
+			if (peer.second->IsRoundOpen())
+			{
+				m_sendOrder.push_back(peer.second);
+			}
+		}
 
-				// serialize everything to the send buffer
-				if (packet.ToBuffer(m_sendBuffer, s_bufferSize))
+		// they take turns by ID from where the last pass stopped, the map order would favor the same ones every time
+		std::sort(m_sendOrder.begin(), m_sendOrder.end(), [](const RemotePeer* a, const RemotePeer* b) { return a->m_assignedID < b->m_assignedID; });
+		size_t first = 0;
+		while (first < m_sendOrder.size() && m_sendOrder[first]->m_assignedID < m_egressCursor) { first++; }
+
+		// send paced packets until the queues are empty, the round budgets are spent or the congestion windows are full
+		// with an egress budget every turn is a deficit round robin quantum, without one a peer sends all it can in its turn
+		bool limited = (m_egressBudget != 0);
+		if (!limited && m_sendWorkers && m_sendOrder.size() >= s_minimumParallelPeers)
+		{
+			// the turns are independent without a budget, so the peers are built at the same time
+			sendParallel(now, first);
+		}
+		else if (!limited)
+		{
+			for (size_t i = 0; i < m_sendOrder.size(); i++)
+			{
+				RemotePeer* remote = m_sendOrder[(first + i) % m_sendOrder.size()];
+				if (!isReadyToSend(remote, now))
 				{
-					// dont send the message if fake packet loss quicks in
-					if ((m_fakePacketLoss > 0.0f) && (m_rng.GetFloat() <= m_fakePacketLoss))
+					if (!remote->IsRoundOpen())
 					{
-						Log::Info("send: Fake Packet Loss kicked in!");
-						peer.second->UpdateLastSend();
+						remote->EgressIdle();
 					}
-					else
+					continue;
+				}
+
+				do
+				{
+					uint32_t size = sendPacket(remote);
+					if (size == 0)
 					{
-						uint32_t sent = 0;
-						bool success = m_socket.Send(peer.second->Address(), m_sendBuffer, packet.Size(), &sent);
+						remote->CloseRound();
+						break;
+					}
+					remote->PacePacket(size, m_sendTime, m_lastSendPass);
+					countEgress(remote, size);
+				} while (isReadyToSend(remote, now));
+				m_egressCursor = (uint16_t)(remote->m_assignedID + 1);
+			}
+		}
+		else
+		{
+			// the peer at the cursor spends its quantum before the next one gets its own, waiting for its pacing if that lets it go in this tick
+			// (going on with the others would make the shares follow the pacing instead of the weights)
+			size_t index = first;
+			size_t passed = 0;
+			while (m_egressAllowance > 0 && passed < m_sendOrder.size())
+			{
+				RemotePeer* remote = m_sendOrder[index % m_sendOrder.size()];
+				if (remote->m_assignedID != m_egressCursor)
+				{
+					m_egressCursor = remote->m_assignedID;
+					m_egressTurnOpen = false;
+				}
 
-						if (success)
-						{
-							peer.second->UpdateLastSend();
-						}
-						else
-						{
-							Log::Warn("Socket::Send failed!");
-						}
+				bool ready = isReadyToSend(remote, now);
+				if (!ready && !canSendInEgressTick(remote, now))
+				{
+					if (!remote->IsRoundOpen())
+					{
+						remote->EgressIdle();
 					}
+					m_egressCursor = (uint16_t)(remote->m_assignedID + 1);
+					m_egressTurnOpen = false;
+					index++;
+					passed++;
+					continue;
 				}
-				else
+
+				// a peer still paying for a big packet only gets its quantum this turn
+				if (!m_egressTurnOpen)
+				{
+					remote->EgressTurn(s_egressQuantum);
+					m_egressTurnOpen = true;
+					passed = 0;
+				}
+				if (remote->EgressDeficit() <= 0)
+				{
+					m_egressCursor = (uint16_t)(remote->m_assignedID + 1);
+					m_egressTurnOpen = false;
+					index++;
+					passed++;
+					continue;
+				}
+				if (!ready) { break; }
+
+				// packets of about what is left of the turn, with big path MTUs a single one could take several ticks of budget
+				int32_t deficit = remote->EgressDeficit();
+				uint32_t size = sendPacket(remote, (deficit > (int32_t)s_egressQuantum) ? (uint32_t)deficit : s_egressQuantum);
+				if (size == 0)
+				{
+					remote->CloseRound();
+					continue;
+				}
+				remote->PacePacket(size, m_sendTime, m_lastSendPass);
+				countEgress(remote, size);
+				passed = 0;
+			}
+		}
+
+		// the ones that could still send wait for the next tick
+		if (limited && m_egressAllowance <= 0)
+		{
+			for (RemotePeer* remote : m_sendOrder)
+			{
+				if (isReadyToSend(remote, now))
+				{
+					remote->SetEgressDeferred(true);
+				}
+			}
+		}
+
+		for (std::pair<const uint8_t, RemotePeer*>& peer : m_peers)
+		{
+			RemotePeer* remote = peer.second;
+
+			// the last packets of a burst rarely fill a group, their parity goes once the round has nothing more to send
+			if (remote->IsFECEnabled() && !remote->IsRoundOpen() && remote->GetFECEncoder().CloseGroup())
+			{
+				sendFECParity(remote);
+			}
+
+			// nothing went, but the remote peer is waiting for our acks (acks alone dont follow the send rate nor the egress budget)
+			if (remote->IsAckDue(s_maxAckDelay, now))
+			{
+				sendAck(remote, remote->CurrentSequenceIn());
+			}
+
+			// a burst can bring more sequences than the ack bits cover, the older ones get acks of their own
+			// only a few every pass, the rest wait for the delayed ack deadline so a burst isnt answered with a storm
+			if (remote->IsUncoveredAckDue(now))
+			{
+				uint16_t uncovered;
+				uint32_t acks = 0;
+				while (acks < s_maxUncoveredAcks && remote->UncoveredSequence(uncovered))
 				{
-					Log::Error("send: Packet::ToBuffer failed");
+					sendAck(remote, uncovered);
+					acks++;
 				}
+				if (acks == s_maxUncoveredAcks)
+				{
+					remote->DelayUncoveredAcks(now + s_maxAckDelay);
+				}
+			}
+
+			// look for bigger packet sizes once the connection is up
+			bool connected = IsServer() ? (remote->State() == NetPeerState::Connected) : (m_state == NetPeerState::Connected);
+			if (connected && remote->IsMTUProbeDue(now))
+			{
+				sendMTUProbe(remote, now);
+			}
+		}
+
+		m_lastSendPass = now;
+	}
+
+	// keep a built packet for the batch, the remote address is copied since the peer only hands it by value
+	static void addDatagram(NetSendBatch& batch, RemotePeer* peer, uint32_t size, bool parity)
+	{
+		NetDatagram datagram = { peer, peer->Address(), (uint32_t)batch.m_bytes.size(), size, parity };
+		batch.m_bytes.insert(batch.m_bytes.end(), batch.m_buffer.begin(), batch.m_buffer.begin() + size);
+		batch.m_datagrams.push_back(datagram);
+	}
+
+	void Peer::sendParallel(uint64_t now, size_t first)
+	{
+		// each peer is only ever touched by the thread that took it, the shared state waits for the batch
+		size_t count = m_sendOrder.size();
+		m_sendTurns.assign(count, 0);
+		m_sendWorkers->Run((uint32_t)count, [this, now, first, count](uint32_t worker, uint32_t turn)
+		{
+			RemotePeer* remote = m_sendOrder[(first + turn) % count];
+			NetSendBatch& batch = m_sendBatches[worker];
+			if (!isReadyToSend(remote, now))
+			{
+				if (!remote->IsRoundOpen())
+				{
+					remote->EgressIdle();
+				}
+				return;
+			}
+
+			m_sendTurns[turn] = 1;
+			do
+			{
+				bool serialized = false;
+				bool groupComplete = false;
+				uint32_t size = buildPacket(remote, batch.m_buffer.data(), serialized, groupComplete);
+				if (size == 0)
+				{
+					remote->CloseRound();
+					break;
+				}
+				if (serialized)
+				{
+					addDatagram(batch, remote, size, false);
+					// the parity goes right after the packet that completed its group, before the next one starts another
+					uint32_t paritySize = groupComplete ? buildFECParity(remote, batch.m_buffer.data()) : 0;
+					if (paritySize > 0)
+					{
+						addDatagram(batch, remote, paritySize, true);
+					}
+				}
+				remote->PacePacket(size, m_sendTime, m_lastSendPass);
+			} while (isReadyToSend(remote, now));
+		});
+
+		submitBatches();
 
-				// return the reliable back to the peer
-				packet.BackupReliables(peer.second);
+		// the next pass starts after the last one that took its turn
+		for (size_t turn = 0; turn < count; turn++)
+		{
+			if (m_sendTurns[turn] != 0)
+			{
+				m_egressCursor = (uint16_t)(m_sendOrder[(first + turn) % count]->m_assignedID + 1);
 			}
 		}
 	}
 
+	void Peer::submitBatches()
+	{
+		m_socketBatch.clear();
+		m_socketBatchSources.clear();
+		for (NetSendBatch& batch : m_sendBatches)
+		{
+			for (NetDatagram& datagram : batch.m_datagrams)
+			{
+				if (!datagram.m_parity)
+				{
+					countEgress(datagram.m_peer, datagram.m_size);
+				}
+
+				// dont send the message if fake packet loss quicks in
+				if ((m_fakePacketLoss > 0.0f) && (m_rng.GetFloat() <= m_fakePacketLoss))
+				{
+					Log::Info("send: Fake Packet Loss kicked in!");
+					if (!datagram.m_parity)
+					{
+						datagram.m_peer->UpdateLastSend(m_now);
+					}
+					continue;
+				}
+
+				UDPDatagram socketDatagram = { &datagram.m_remote, batch.m_bytes.data() + datagram.m_offset, datagram.m_size };
+				m_socketBatch.push_back(socketDatagram);
+				m_socketBatchSources.push_back(&datagram);
+			}
+		}
+
+		uint32_t done = 0;
+		uint32_t total = (uint32_t)m_socketBatch.size();
+		while (done < total)
+		{
+			uint32_t sent = m_socket.SendBatch(&m_socketBatch[done], total - done);
+			for (uint32_t i = done; i < done + sent; i++)
+			{
+				NetDatagram* datagram = m_socketBatchSources[i];
+				if (!datagram->m_parity)
+				{
+					datagram->m_peer->UpdateLastSend(m_now);
+				}
+				datagram->m_peer->CountSent(datagram->m_size);
+			}
+			done += sent;
+
+			// the one that failed is lost, like with a single send
+			if (done < total)
+			{
+				Log::Warn("Socket::Send failed!");
+				done++;
+			}
+		}
+
+		for (NetSendBatch& batch : m_sendBatches)
+		{
+			batch.m_bytes.clear();
+			batch.m_datagrams.clear();
+		}
+	}
+
+	bool Peer::isReadyToSend(RemotePeer* peer, uint64_t now)
+	{
+		if (!peer->IsRoundOpen()) { return false; }
+
+		if ((!peer->HaveMessagesPending() && !peer->HaveReliableMessagesDue(now) && !peer->HaveBulkChunksReady()) || peer->RoundBudget() == 0)
+		{
+			peer->CloseRound();
+			return false;
+		}
+		return peer->CongestionWindowRoom(now) > 0 && peer->IsPacketPaced(now);
+	}
+
+	bool Peer::canSendInEgressTick(RemotePeer* peer, uint64_t now)
+	{
+		if (!peer->IsRoundOpen() || peer->RoundBudget() == 0) { return false; }
+		if (!peer->HaveMessagesPending() && !peer->HaveReliableMessagesDue(now) && !peer->HaveBulkChunksReady()) { return false; }
+
+		// a full congestion window can take longer than the tick, the pacing can't
+		return peer->NextPacketTime() < m_nextEgressTick && peer->CongestionWindowRoom(now) > 0;
+	}
+
+	void Peer::countEgress(RemotePeer* peer, uint32_t bytes)
+	{
+		m_egressStats.m_sentBytes += bytes;
+		if (peer->EgressLate())
+		{
+			m_egressStats.m_delayedBytes += bytes;
+		}
+		if (m_egressBudget != 0)
+		{
+			m_egressAllowance -= bytes;
+			peer->EgressSent(bytes);
+		}
+	}
+
+	void Peer::closeEgressTick(uint64_t now)
+	{
+		bool report = (m_egressBudget != 0 && m_nextEgressTick != 0);
+		for (std::pair<const uint8_t, RemotePeer*>& peer : m_peers)
+		{
+			RemotePeer* remote = peer.second;
+			if (report && remote->EgressDeferred())
+			{
+				m_egressStats.m_deferredBytes += remote->PendingBytes();
+				m_egressStats.m_deferredPeers++;
+			}
+			remote->SetEgressLate(remote->EgressDeferred());
+			remote->SetEgressDeferred(false);
+		}
+
+		if (report)
+		{
+			m_egressStats.m_budget = m_egressBudget;
+			raiseEgressTick(m_egressStats);
+		}
+		m_egressStats = NetEgressStats();
+
+		// a packet that went over is taken from the next tick
+		m_egressAllowance = ((m_egressAllowance < 0) ? m_egressAllowance : 0) + m_egressBudget;
+		// keep the ticks at the send rate unless some were skipped
+		m_nextEgressTick = (m_nextEgressTick == 0 || (now - m_nextEgressTick) >= m_sendTime) ? (now + m_sendTime) : (m_nextEgressTick + m_sendTime);
+	}
+
+	void Peer::flush(RemotePeer* peer)
+	{
+		// called by the game between updates, so the snapshot is taken again
+		m_now = Utils::GetElapsedMicroseconds();
+		// it still counts against the round and egress budgets and pushes the next paced packet back
+		while ((peer->HaveMessagesPending() || peer->HaveReliableMessagesDue(m_now)) && peer->CongestionWindowRoom(m_now) > 0)
+		{
+			uint32_t size = sendPacket(peer);
+			if (size == 0) { break; }
+			peer->PacePacket(size, m_sendTime, m_now);
+			countEgress(peer, size);
+		}
+	}
+
+	uint32_t Peer::sendPacket(RemotePeer* peer, uint32_t targetSize)
+	{
+		bool serialized = false;
+		bool groupComplete = false;
+		uint32_t size = buildPacket(peer, m_sendBuffer, serialized, groupComplete, targetSize);
+		if (serialized)
+		{
+			submitPacket(peer, m_sendBuffer, size, false);
+			if (groupComplete)
+			{
+				sendFECParity(peer);
+			}
+		}
+		return size;
+	}
+
+	uint32_t Peer::buildPacket(RemotePeer* peer, uint8_t* buffer, bool& serialized, bool& groupComplete, uint32_t targetSize)
+	{
+		Packet packet;
+		uint32_t maximumSize = peer->MaximumPacketSize();
+
+		// leave room for the group info and for the parity packet being able to cover this one
+		bool fec = peer->IsFECEnabled();
+		if (fec)
+		{
+			maximumSize -= s_fecReservedSize;
+		}
+		// every message can still take the whole packet, the target only stops adding more
+		targetSize = (targetSize == 0 || targetSize > maximumSize) ? maximumSize : targetSize;
+
+		// first put every ack-pending reliable which timeout expired
+		while (packet.Size() < targetSize)
+		{
+			bool added = packet.AddMessage(peer->DequeueReliableMessage(maximumSize - packet.Size(), m_now));
+			if (!added) { break; }
+		}
+
+		// if we have room for more messages
+		while (packet.Size() < targetSize)
+		{
+			// try to add a pending message
+			bool added = packet.AddMessage(peer->DequeueMessage(maximumSize - packet.Size(), m_now));
+			if (!added) { break; }
+		}
+
+		// and fill the rest with the last unacked copies of redundant messages
+		while (packet.Size() < targetSize)
+		{
+			bool added = packet.AddMessage(peer->DequeueRedundantMessage(maximumSize - packet.Size(), m_now));
+			if (!added) { break; }
+		}
+
+		// bulk transfers only get what the game traffic left
+		while (packet.Size() < targetSize)
+		{
+			bool added = packet.AddMessage(peer->DequeueBulkChunk(maximumSize - packet.Size()));
+			if (!added) { break; }
+		}
+
+		// if theres no messages, theres nothing to send
+		if (packet.MessageCount() == 0) { return 0; }
+
+		// tag the packet with its parity group
+		if (fec)
+		{
+			std::unique_ptr<MessageFECGroup> group = MessageFECGroup::Create();
+			peer->GetFECEncoder().NextPacket(peer->FECGroupSize(), group->m_group, group->m_index, group->m_count);
+			packet.AddMessage(std::move(group));
+		}
+
+		// generate the headers for both packet and messages
+		packet.GeneratePacketHeader(peer, m_now);
+		packet.GenerateMessageHeaders(peer);
+		packet.EncodeDeltas();
+		peer->AcksSent(peer->CurrentSequenceIn());
+		uint32_t size = packet.Size();
+
+#if QUICKNET_VERBOSE
+		std::ostringstream ss;
+		ss << "Sending packet with " << packet.MessageCount() << " messages inside";
+		Log::Info(ss.str());
+#endif
+
+		// serialize everything to the buffer
+		serialized = packet.ToBuffer(buffer, s_bufferSize);
+		if (serialized)
+		{
+			// the parity covers it even if it gets lost right after
+			groupComplete = fec && peer->GetFECEncoder().AddPacket(buffer, size);
+
+			// lost or not, its in flight until we know
+			uint16_t newestSequence;
+			if (packet.NewestSequence(newestSequence))
+			{
+				peer->PacketSent(newestSequence, size, m_now);
+			}
+		}
+		else
+		{
+			Log::Error("send: Packet::ToBuffer failed");
+		}
+
+		// return the reliable back to the peer
+		packet.BackupReliables(peer, m_now);
+
+		return size;
+	}
+
+	void Peer::submitPacket(RemotePeer* peer, uint8_t* data, uint32_t size, bool parity)
+	{
+		// dont send the message if fake packet loss quicks in
+		if ((m_fakePacketLoss > 0.0f) && (m_rng.GetFloat() <= m_fakePacketLoss))
+		{
+			Log::Info(parity ? "sendFECParity: Fake Packet Loss kicked in!" : "send: Fake Packet Loss kicked in!");
+			if (!parity)
+			{
+				peer->UpdateLastSend(m_now);
+			}
+			return;
+		}
+
+		uint32_t sent = 0;
+		if (m_socket.Send(peer->Address(), data, size, &sent))
+		{
+			if (!parity)
+			{
+				peer->UpdateLastSend(m_now);
+			}
+			peer->CountSent(size);
+		}
+		else
+		{
+			Log::Warn("Socket::Send failed!");
+		}
+	}
+
+	void Peer::sendAck(RemotePeer* peer, uint16_t sequence)
+	{
+		// just the packet header
+		Packet packet;
+		packet.GeneratePacketHeader(peer, sequence, m_now);
+		peer->AcksSent(sequence);
+
+		if (packet.ToBuffer(m_sendBuffer, s_bufferSize))
+		{
+			// dont send the message if fake packet loss quicks in
+			if ((m_fakePacketLoss > 0.0f) && (m_rng.GetFloat() <= m_fakePacketLoss))
+			{
+				Log::Info("sendAck: Fake Packet Loss kicked in!");
+				return;
+			}
+			uint32_t sent = 0;
+			if (m_socket.Send(peer->Address(), m_sendBuffer, packet.Size(), &sent))
+			{
+				peer->CountSent(packet.Size());
+			}
+			else
+			{
+				Log::Warn("Socket::Send failed!");
+			}
+		}
+		else
+		{
+			Log::Error("sendAck: Packet::ToBuffer failed");
+		}
+	}
+
+	void Peer::sendMTUProbe(RemotePeer* peer, uint64_t now)
+	{
+		uint32_t size = peer->NextMTUProbeSize();
+		uint32_t overhead = PacketHeader::Size() + MessageHeader::Size() + MessageMTUProbe::FixedSize();
+		if (size <= overhead || size > s_bufferSize) { return; }
+
+		std::unique_ptr<MessageMTUProbe> probe = MessageMTUProbe::Create();
+		probe->m_padding.resize(size - overhead);
+
+		Packet packet;
+		packet.AddMessage(std::move(probe));
+		packet.GeneratePacketHeader(peer, m_now);
+		packet.GenerateMessageHeaders(peer);
+
+		uint16_t sequence;
+		if (!packet.NewestSequence(sequence) || !packet.ToBuffer(m_sendBuffer, s_bufferSize))
+		{
+			Log::Error("sendMTUProbe: Packet::ToBuffer failed");
+			return;
+		}
+
+		// lost probes are expected, they dont count as congestion
+		peer->MTUProbeSent(sequence, size, now);
+		if ((m_fakePacketLoss > 0.0f) && (m_rng.GetFloat() <= m_fakePacketLoss))
+		{
+			Log::Info("sendMTUProbe: Fake Packet Loss kicked in!");
+			return;
+		}
+
+		uint32_t sent = 0;
+		if (m_socket.Send(peer->Address(), m_sendBuffer, size, &sent))
+		{
+			peer->CountSent(size);
+		}
+		else
+		{
+			// too big for the local interface
+			peer->MTUProbeFailed(size, now);
+		}
+	}
+
+	void Peer::sendFECParity(RemotePeer* peer)
+	{
+		uint32_t size = buildFECParity(peer, m_sendBuffer);
+		if (size > 0)
+		{
+			submitPacket(peer, m_sendBuffer, size, true);
+		}
+	}
+
+	uint32_t Peer::buildFECParity(RemotePeer* peer, uint8_t* buffer)
+	{
+		const FECEncoder& encoder = peer->GetFECEncoder();
+
+		std::unique_ptr<MessageFECParity> parity = MessageFECParity::Create();
+		parity->m_group = encoder.Group();
+		parity->m_count = encoder.Count();
+		parity->m_lengthXor = encoder.LengthXor();
+		parity->m_parity = encoder.Parity();
+
+		Packet packet;
+		packet.AddMessage(std::move(parity));
+		packet.GeneratePacketHeader(peer, m_now);
+		packet.GenerateMessageHeaders(peer);
+
+		if (!packet.ToBuffer(buffer, s_bufferSize))
+		{
+			Log::Error("sendFECParity: Packet::ToBuffer failed");
+			return 0;
+		}
+		return packet.Size();
+	}
+
 	bool Peer::sendMessage(const Address& address, std::unique_ptr<Message> message)
 	{
 #if QUICKNET_VERBOSE
@@ -1028,7 +2654,7 @@ namespace quicknet
 
 		Packet packet;
 		packet.AddMessage(std::move(message));
-		packet.GeneratePacketHeader(nullptr);
+		packet.GeneratePacketHeader(nullptr, m_now);
 		packet.GenerateMessageHeaders(nullptr);
 
 		if (packet.ToBuffer(m_sendBuffer, s_bufferSize))
@@ -22,6 +22,12 @@
 
 #pragma once
 #include <unordered_map> // O(1) find() vs O(logN) of normal map
+#include <vector>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <atomic>
 
 #define QUICKNET_VERBOSE 0
 
@@ -29,12 +35,17 @@
 #include "quicknet_udpsocket.h"
 #include "quicknet_latencyfaker.h"
 #include "quicknet_fastrand.h"
+#include "quicknet_congestion.h"
+#include "quicknet_bulktransfer.h"
+#include "quicknet_ring.h"
+#include "quicknet_workerpool.h"
 
 namespace quicknet
 {
 	class RemotePeer;
 	class Message;
 	class PacketHeader;
+	class MessageFECParity;
 
 	enum NetPeerState
 	{
@@ -45,6 +56,167 @@ namespace quicknet
 		ServerMode
 	};
 
+	// when the messages queued for a remote peer leave
+	enum NetSendMode
+	{
+		Batched,   // together on every send round
+		Immediate, // on the next update, with whatever else was queued by then
+		Coalesced  // once they fill a packet or the oldest one waited the coalescing window
+	};
+
+	// how many of the send rounds a remote peer gets, the lower tiers get the budget of the ones they skip
+	// so spectators or idle players cost fewer packets and less time per tick
+	enum NetSendTier
+	{
+		Full,     // every round
+		Half,     // one in 2
+		Quarter,  // one in 4
+		Eighth,   // one in 8
+		Automatic // full while the game sends to it, one tier lower for every second it doesn't (down to a quarter)
+	};
+
+	// how the messages of a numbered channel are sent and delivered
+	enum NetChannelMode
+	{
+		Unreliable,        // may be lost or arrive in any order
+		Sequenced,         // may be lost, older ones arriving after a newer one are dropped
+		ReliableOrdered,   // always arrive, held back until the ones before them arrived
+		ReliableUnordered  // always arrive, as soon as they do
+	};
+
+	// what SendTo does with a new message when a remote peer is over its queue limits
+	enum NetQueuePolicy
+	{
+		DropOldest, // drop its oldest queued unreliables (lowest priority channel first) to make room, refuse it if that isn't enough
+		Reject,     // refuse it
+		Disconnect  // disconnect the remote peer
+	};
+
+	// how a send went
+	enum NetSendResult
+	{
+		Queued,     // it will go out
+		WouldBlock, // the remote peer is over its queue limits, the message was not taken
+		Failed      // no such remote peer, the message can't be sent or the peer was disconnected for going over its limits
+	};
+
+	// connection statistics for one remote peer, times in microseconds
+	struct NetPeerStats
+	{
+		uint32_t m_rtt;         // smoothed round trip time
+		uint32_t m_rttVariance; // round trip time variation
+		uint32_t m_rto;         // current retransmission timeout
+		uint64_t m_resends;     // reliable messages sent again
+		uint64_t m_fastResends; // resends triggered by skipped acks instead of timeouts
+		float    m_packetLoss;  // estimated from the acks, 0.0f to 1.0f
+		uint8_t  m_fecGroupSize;   // packets covered by each parity packet
+		uint64_t m_fecRecovered;   // lost packets rebuilt from parity
+		uint64_t m_deadlineDrops;  // messages dropped because their ttl expired
+		uint32_t m_minRTT;           // lowest round trip time seen in the last seconds
+		uint32_t m_bytesInFlight;    // sent but not acked or lost yet
+		uint32_t m_congestionWindow; // how many bytes can be in flight (0 without congestion control)
+		uint32_t m_bandwidth;        // acked bytes per second
+		uint32_t m_pacingRate;       // bytes per second the packets are spread at
+		uint32_t m_datagramSize;     // biggest packet confirmed to get through the path
+		uint32_t m_reassemblyBytes;  // held for fragmented messages still missing pieces
+		uint8_t  m_roundDivisor;     // the remote peer gets one send round in this many
+		uint32_t m_queuedBytes;       // messages waiting to be sent
+		uint32_t m_queuedMessages;
+		uint32_t m_reliablesInFlight; // sent and waiting for their ack
+		uint32_t m_heldBytes;         // memory held for the remote peer: queued, unacked and redundant messages and reassembly
+		uint64_t m_queueDrops;        // queued unreliables dropped to make room
+		uint64_t m_queueRejects;      // messages refused for going over the queue limits
+		uint64_t m_superseded;        // queued messages replaced by a newer one with the same key
+		uint64_t m_bytesSent;        // datagram bytes, headers included
+		uint64_t m_bytesReceived;
+		uint64_t m_packetsSent;
+		uint64_t m_packetsReceived;
+	};
+
+	// how a send tick used the server-wide egress budget, in bytes (acks and MTU probes are not counted)
+	struct NetEgressStats
+	{
+		uint32_t m_budget;        // allowed on the tick
+		uint32_t m_sentBytes;     // sent on the tick, flushes and urgent messages included
+		uint32_t m_delayedBytes;  // sent by remote peers the budget held back on the tick before
+		uint32_t m_deferredBytes; // left queued on the remote peers the budget held back, they go on the next ticks
+		uint16_t m_deferredPeers; // remote peers the budget held back
+	};
+
+	// how the last UpdateNetwork used its receive budget
+	struct NetUpdateStats
+	{
+		uint32_t m_receiveTime;  // microseconds reading the socket and processing what came, system messages included
+		uint32_t m_deliverTime;  // microseconds handing game messages to the game
+		uint32_t m_datagrams;    // read from the socket
+		uint32_t m_gameMessages; // handed to the game
+		uint32_t m_backlog;      // game messages left for the next updates
+		uint64_t m_overruns;     // updates so far cut short by the budget
+	};
+
+	// a callback the network thread leaves for the game thread
+	enum class NetEventType : uint8_t
+	{
+		Connection,
+		Disconnection,
+		GameMessage,
+		Delivered,
+		Lost,
+		TransferProgress,
+		TransferIncoming,
+		TransferReceived,
+		EgressTick
+	};
+
+	struct NetEvent
+	{
+		NetEventType m_type;
+		uint8_t  m_peerID;
+		uint16_t m_transferID;
+		uint32_t m_bytes;
+		uint32_t m_total;
+		std::unique_ptr<Message> m_message;
+		std::vector<uint32_t> m_handles;
+		std::vector<uint8_t> m_data;
+		NetEgressStats m_egress;
+	};
+
+	// work the game thread leaves for the network thread
+	enum class NetOutboundType : uint8_t
+	{
+		Send,
+		SendToAll,
+		Flush,
+		Disconnect,
+		DisconnectAll
+	};
+
+	struct NetOutbound
+	{
+		NetOutboundType m_type;
+		uint8_t  m_peerID;
+		uint32_t m_ttl; // or how many disconnection messages a Disconnect sends
+		std::unique_ptr<Message> m_message;
+	};
+
+	// a packet a send worker built, it goes out with the rest of the batch
+	struct NetDatagram
+	{
+		RemotePeer* m_peer;
+		Address  m_remote;
+		uint32_t m_offset; // in the bytes of its worker
+		uint32_t m_size;
+		bool     m_parity;
+	};
+
+	// what a send worker builds on every send pass, in buffers of its own
+	struct NetSendBatch
+	{
+		std::vector<uint8_t> m_buffer;
+		std::vector<uint8_t> m_bytes;
+		std::vector<NetDatagram> m_datagrams;
+	};
+
 	class Peer
 	{
 	public:
@@ -59,30 +231,111 @@ namespace quicknet
 		// send disconnection message & remove all remote peers
 		void DisconnectAll();
 		// receive and process packets & update peers state
+		// with the network thread running it only hands over to the game what the thread got
 		void UpdateNetwork();
+		// run the network on its own thread, so receive, acks, keepalives and sends go on while the game thread stalls
+		// SendTo, TrySendTo, SendToAll, Flush and DisconnectAll pass their work to it from any thread (SendTo only tells if it was taken)
+		// connect and configure the peer before starting it, the other calls need it stopped (the setters return false from the game thread while it runs)
+		// interval is how long the thread sleeps between passes, in microseconds
+		bool StartNetworkThread(uint32_t interval = 1000);
+		// stop it, what it left for the game is handed over right away
+		void StopNetworkThread();
+		bool IsNetworkThreaded() const { return m_threaded; }
 		// send message to specific remote peer
-		bool SendTo(uint8_t peerID, std::unique_ptr<Message> message);
+		// messages bigger than a packet are split in fragments, sent as reliable as the whole message
+		// with a ttl (milliseconds) the message is dropped instead of sent or resent once it expires, except on reliable ordered channels that need every message
+		// false if the peer doesn't exist or refused it for being over its queue limits
+		bool SendTo(uint8_t peerID, std::unique_ptr<Message> message, uint32_t ttl = 0);
+		// the same, but a message the remote peer has no room for is left untouched to try again later
+		NetSendResult TrySendTo(uint8_t peerID, std::unique_ptr<Message>& message, uint32_t ttl = 0);
 		// send message to specific remote peer
-		bool SendTo(RemotePeer* peer, std::unique_ptr<Message> message);
-		// send message to all the remote peers
-		bool SendToAll(std::unique_ptr<Message> message);
+		bool SendTo(RemotePeer* peer, std::unique_ptr<Message> message, uint32_t ttl = 0);
+		// send right away whatever is queued for a remote peer instead of waiting for its send round
+		bool Flush(uint8_t peerID);
+		// send message to all the remote peers, false if any of them refused it
+		bool SendToAll(std::unique_ptr<Message> message, uint32_t ttl = 0);
+		// the same from any thread at the same time, without locks: the message is taken on the next update (or by the network thread)
+		// false if the ring of the calling thread is full, only the messages of one thread keep their order between them
+		bool PostTo(uint8_t peerID, std::unique_ptr<Message> message, uint32_t ttl = 0);
+		bool PostToAll(std::unique_ptr<Message> message, uint32_t ttl = 0);
+		// stream a file to a remote peer straight from a memory mapping, in reliable chunks that only take what the game traffic leaves
+		// transferID identifies it in the transfer callbacks, false if the file can't be mapped
+		bool SendFile(uint8_t peerID, const std::string& path, uint16_t& transferID);
+		// the same from memory, kept by the transfer until its done
+		bool SendBlob(uint8_t peerID, std::vector<uint8_t> data, uint16_t& transferID);
 
 		// we need to select the mode on runtime
-		void SetServerMode(bool enable);
+		// the settings below change what the network thread works with, they return false from the game thread while it runs
+		bool SetServerMode(bool enable);
+		// send rounds per second (20 by default, 128 at most), every remote peer gets its send budget on each one
+		bool SetSendRate(uint32_t rate);
+		uint32_t SendRate() const { return (uint32_t)(1000 * 1000 / m_sendTime); }
+
+		// send parity packets to a remote peer so it can rebuild lost packets without resends
+		bool SetFEC(uint8_t peerID, bool enable);
+		// how many unacked copies of each redundant message kind go along every packet to a remote peer
+		bool SetRedundancy(uint8_t peerID, uint8_t copies);
 
+		// after how many received packets an ack goes back to a remote peer with nothing else to send
+		// (higher saves upstream bandwidth on heavy downstream traffic, acks are still sent after a short delay)
+		bool SetAckFrequency(uint8_t peerID, uint8_t packets);
+		// biggest datagram path MTU discovery will try with a remote peer (packets start at 1200 bytes and grow up to it)
+		bool SetMaximumDatagramSize(uint8_t peerID, uint32_t bytes);
+		// memory the fragmented messages from a remote peer can take while they are put together (4 MB by default)
+		bool SetReassemblyLimit(uint8_t peerID, uint32_t bytes);
+		// when the messages to a remote peer leave (batched on every send round by default)
+		// coalesced ones wait up to window milliseconds for more to fill the packet, for chatty low priority traffic
+		bool SetSendMode(uint8_t peerID, NetSendMode mode, uint32_t window = 100);
+		// how many of the send rounds a remote peer gets (all of them by default), urgent messages and flushes still go right away
+		bool SetSendTier(uint8_t peerID, NetSendTier tier);
+		// bytes all the remote peers together can take on every send tick (0 for no limit, the default)
+		// once its reached the rest wait for the next tick, the peers share it by weight in deficit round robin
+		bool SetEgressBudget(uint32_t bytes);
+		uint32_t EgressBudget() const { return m_egressBudget; }
+		// threads that build and serialize the packets of different remote peers along with the updating one (0 for none, the default)
+		// the packets then go out together in one batch, it only applies without an egress budget (that one hands the turns in order)
+		// they only pay off with cores to spare, on a single core they cost more than they build (test/throughput compares them)
+		// false while the network thread runs, its sends would use the workers being replaced
+		bool SetSendWorkers(uint32_t workers);
+		uint32_t SendWorkers() const { return m_sendWorkers ? m_sendWorkers->Threads() : 0; }
+		// share of the egress budget a remote peer gets against the others (1 by default), its channels share it by their own weights
+		bool SetEgressWeight(uint8_t peerID, uint16_t weight);
+		// send mode of a numbered channel to a remote peer (the receiver gets it from the messages) and how it shares the packets
+		// higher priorities go first, channels of the same priority share the bytes by weight (channel 0 keeps the message flags mode)
+		// each channel has its own order, so a late message only holds back the ones after it on its channel
+		bool SetChannel(uint8_t peerID, uint8_t channel, NetChannelMode mode, uint8_t priority = 0, uint16_t weight = 1);
+		// limits on what a remote peer can hold, over them new messages follow the policy (0 for no limit)
+		// queued bytes and messages wait to be sent, reliables wait for their ack (4 MB, 131072 and no limit by default)
+		// the connection, keepalive and disconnection messages of the peer itself are never held to them
+		bool SetQueueLimits(uint8_t peerID, uint32_t bytes, uint32_t messages, uint32_t reliables, NetQueuePolicy policy = NetQueuePolicy::DropOldest);
+		// percent of the send budget bulk transfers to a remote peer can take (50 by default)
+		bool SetBulkShare(uint8_t peerID, uint8_t percent);
+		// maximum bytes sent to a remote peer on every send tick (the congestion window can limit it further)
+		bool SetSendBudget(uint8_t peerID, uint32_t bytes);
+		// replace how the traffic to a remote peer adapts to the link (AIMD by default, nullptr for no limit)
+		bool SetCongestionController(uint8_t peerID, std::unique_ptr<CongestionController> controller);
+		// time in microseconds and datagrams each UpdateNetwork can spend on what arrives (0 for no limit, the default)
+		// with a budget system messages go first and game messages wait in a backlog, what doesn't fit stays for the next updates
+		// with the network thread running the time budget limits how long UpdateNetwork hands its events over
+		bool SetUpdateBudget(uint32_t microseconds, uint32_t datagrams);
+		const NetUpdateStats& UpdateStats() const { return m_threaded ? m_gameUpdateStats : m_updateStats; }
 		// set a fake packet loss from 0.0f to 1.0f
-		void  SetFakePacketLoss(float percentage);
+		bool  SetFakePacketLoss(float percentage);
 		float CurrentFakePacketLoss() const { return m_fakePacketLoss; }
 
 		// set fake latency in milliseconds
-		void  SetFakeLatency(uint32_t milliseconds);
+		bool  SetFakeLatency(uint32_t milliseconds);
 		uint32_t CurrentFakeLatency() const { return m_fakeLatency.CurrentLatency(); }
 
 		// current state and mode getters
-		const NetPeerState NetworkState() const { return m_state; }
-		// round trip time from client to server or average from server to clients
+		// RTT, GetPeerStats and AssignedID read what the network thread changes, only call them with it stopped
+		// NetworkState, IsServer, UpdateStats and the getters of the settings above are safe (those dont change while it runs)
+		const NetPeerState NetworkState() const { return m_threaded ? m_sharedState.load(std::memory_order_acquire) : m_state; }
+		// round trip time in milliseconds from client to server or average from server to clients
 		const uint32_t RTT();
-		const bool IsServer() const { return m_state == NetPeerState::ServerMode; }
+		const bool IsServer() const { return NetworkState() == NetPeerState::ServerMode; }
+		// fill the connection statistics of a remote peer, false if it doesnt exist
+		bool GetPeerStats(uint8_t peerID, NetPeerStats& stats);
 
 		const uint8_t AssignedID() const { return m_assignedID; }
 	protected:
@@ -90,6 +343,17 @@ namespace quicknet
 		virtual void OnDisconnection(uint8_t peerID) = 0;
 		// this is where the actual game events will be processed
 		virtual void OnGameMessage(const Message* const message) = 0;
+		// handles of the messages a remote peer acked or that can't be acked anymore, batched once per update
+		// (a lost one may still have arrived if all the acks covering it were lost too)
+		virtual void OnDelivered(uint8_t /*peerID*/, const std::vector<uint32_t>& /*handles*/) {}
+		virtual void OnLost(uint8_t /*peerID*/, const std::vector<uint32_t>& /*handles*/) {}
+		// acked bytes of a transfer to a remote peer, once per update while it moves (finished when bytes == total)
+		virtual void OnTransferProgress(uint8_t /*peerID*/, uint16_t /*transferID*/, uint32_t /*bytes*/, uint32_t /*total*/) {}
+		// received bytes of a transfer from a remote peer, and all its data once it arrived
+		virtual void OnTransferIncoming(uint8_t /*peerID*/, uint16_t /*transferID*/, uint32_t /*bytes*/, uint32_t /*total*/) {}
+		virtual void OnTransferReceived(uint8_t /*peerID*/, uint16_t /*transferID*/, const std::vector<uint8_t>& /*data*/) {}
+		// how the last send tick used the egress budget, once per tick while there is one
+		virtual void OnEgressTick(const NetEgressStats& /*stats*/) {}
 
 	private:
 		// add a new peer
@@ -106,15 +370,87 @@ namespace quicknet
 		void updatePeers();
 		// receive packets for processing
 		void receive();
-		// parse the recv buffer
-		void parseBuffer(uint32_t length, RemotePeer* peer);
+		// parse a received packet
+		void parseBuffer(uint8_t* buffer, uint32_t length, RemotePeer* peer);
+		// rebuild a lost packet from its group parity and parse it
+		void recoverFECPacket(RemotePeer* peer, const MessageFECParity* parity);
+		// process a received message, or keep it until its channel order allows it
+		void deliverMessage(std::unique_ptr<Message> message, RemotePeer* peer);
+		// process it now, or put it in the backlog if its a game message and there is an update budget
+		void dispatchMessage(std::unique_ptr<Message> message, RemotePeer* peer);
+		// hand the backlog game messages to the game while the update budget lasts
+		void deliverBacklog();
+		// whether the update used its time or datagrams budget
+		bool isOverBudget(uint32_t datagrams) const;
+		// one pass of receive, maintenance and send
+		void update();
+		// the network thread loop
+		void networkThread(uint32_t interval);
+		// whether the network thread is running and this isn't it
+		bool onGameThread() const;
+		// hand work to the network thread, false if its ring is full (it's left untouched then)
+		bool postOutbound(NetOutbound& outbound);
+		// do the work the other threads left
+		void takeOutbound();
+		void takeOutbound(NetOutbound& outbound);
+		// the callbacks, called right away or left for the game thread while the network thread runs
+		void raiseConnection(uint8_t peerID, bool connected);
+		void raiseHandles(uint8_t peerID, const std::vector<uint32_t>& handles, bool delivered);
+		void raiseTransfer(NetEventType type, uint8_t peerID, uint16_t transferID, uint32_t bytes, uint32_t total);
+		void raiseTransferReceived(uint8_t peerID, uint16_t transferID, std::vector<uint8_t>& data);
+		void raiseEgressTick(const NetEgressStats& stats);
+		void raise(NetEvent& event);
+		// hand the events of the network thread to the game while the update budget lasts (all of them without budget)
+		void deliverEvents(bool budgeted);
+		void dispatchEvent(NetEvent& event);
 		// process new packets
 		void processMessage(const Message* const message, RemotePeer* peer);
 		// update peers state based on new data
 		void processAcks(RemotePeer* peer, PacketHeader& header);
+		// report the delivered and lost handles of every peer, or of one
+		void notifyHandles();
+		void notifyHandles(uint8_t peerID, RemotePeer* peer);
+		// report the progress of the bulk transfers and the finished incoming ones
+		void notifyTransfers();
+		// queue a bulk transfer to a remote peer
+		bool sendBulk(uint8_t peerID, std::shared_ptr<BulkSource> source, uint16_t& transferID);
 		// do the actual send with the specified rate 
 		// and merge the packets to save calls
 		void send();
+		// build the packets of the peers with an open round on the send workers and send them all at once
+		void sendParallel(uint64_t now, size_t first);
+		// send what the workers built, in one batch
+		void submitBatches();
+		// whether a remote peer has something to send in its round and the window and pacing allow it now
+		bool isReadyToSend(RemotePeer* peer, uint64_t now);
+		// whether a remote peer has something to send and its round, window and pacing let it go before the egress tick ends
+		bool canSendInEgressTick(RemotePeer* peer, uint64_t now);
+		// take a sent packet from the egress budget
+		void countEgress(RemotePeer* peer, uint32_t bytes);
+		// report the egress budget use of the tick that ended and give it back
+		void closeEgressTick(uint64_t now);
+		// send packets to a remote peer now, skipping its round and pacing but not its congestion window
+		void flush(RemotePeer* peer);
+		// queue a message under the remote peer limits, it's only taken if the result is Queued
+		NetSendResult sendTo(RemotePeer* peer, std::unique_ptr<Message>& message, uint32_t ttl);
+		// split a message that doesn't fit in a packet and queue the pieces
+		bool sendFragmented(RemotePeer* peer, std::unique_ptr<Message> message, uint32_t pieceSize);
+		// build and send one packet with what fits from the peer queues, returns its size (0 if there was nothing)
+		// with a target size it stops adding messages once it gets there, 0 fills the whole packet
+		uint32_t sendPacket(RemotePeer* peer, uint32_t targetSize = 0);
+		// build it in the given buffer, serialized is false if that failed and groupComplete tells when its parity is due
+		// it only touches the remote peer, so different peers can be built at the same time
+		uint32_t buildPacket(RemotePeer* peer, uint8_t* buffer, bool& serialized, bool& groupComplete, uint32_t targetSize = 0);
+		// send a built packet, unless fake packet loss takes it
+		void submitPacket(RemotePeer* peer, uint8_t* data, uint32_t size, bool parity);
+		// send a packet with only the header, to ack what we received up to the given sequence
+		void sendAck(RemotePeer* peer, uint16_t sequence);
+		// send a padded packet to check if that size gets through the path
+		void sendMTUProbe(RemotePeer* peer, uint64_t now);
+		// send the parity of the last complete group
+		void sendFECParity(RemotePeer* peer);
+		// build it in the given buffer, returns its size (0 if it failed)
+		uint32_t buildFECParity(RemotePeer* peer, uint8_t* buffer);
 		// send one message directly to the specified address
 		bool sendMessage(const Address& address, std::unique_ptr<Message> message);
 
@@ -132,9 +468,57 @@ namespace quicknet
 		uint8_t m_maxPeers;
 		// to keep track of send rate
 		uint64_t m_lastSend;
+		// microseconds between send rounds
+		uint64_t m_sendTime;
+		// last send() pass in microseconds, pacing credit doesnt go further back
+		uint64_t m_lastSendPass;
+		// time snapshot in microseconds taken once per update, the hot paths use it instead of the clock
+		uint64_t m_now;
+		// server-wide egress budget per send tick, what is left of it (negative when the last packet went over) and when it comes back
+		uint32_t m_egressBudget;
+		int64_t m_egressAllowance;
+		uint64_t m_nextEgressTick;
+		// ID of the remote peer whose turn is next, or is going on if it already took its quantum
+		uint16_t m_egressCursor;
+		bool m_egressTurnOpen;
+		NetEgressStats m_egressStats;
+		// reused for the remote peers with an open round, by ID
+		std::vector<RemotePeer*> m_sendOrder;
+		// send workers, their batches (the updating thread uses the first one), which peers took their turn and the datagrams for the socket
+		std::unique_ptr<WorkerPool> m_sendWorkers;
+		std::vector<NetSendBatch> m_sendBatches;
+		std::vector<uint8_t> m_sendTurns;
+		std::vector<UDPDatagram> m_socketBatch;
+		std::vector<NetDatagram*> m_socketBatchSources;
+		// time and datagrams budget of an update, and the game messages that didn't fit in it with their peer IDs
+		uint32_t m_updateBudgetTime;
+		uint32_t m_updateBudgetDatagrams;
+		std::deque<std::pair<uint8_t, std::unique_ptr<Message>>> m_gameBacklog;
+		NetUpdateStats m_updateStats;
+		bool m_overBudget;
+		// network thread, the rings to and from it (the ones to it take any thread) and the events that didn't fit while the game thread was behind
+		std::thread m_networkThread;
+		std::atomic<bool> m_threadRunning;
+		bool m_threaded;
+		std::atomic<NetPeerState> m_sharedState;
+		std::unique_ptr<SPSCRing<NetEvent>> m_events;
+		std::vector<std::unique_ptr<MPSCRing<NetOutbound>>> m_outbound;
+		std::deque<NetEvent> m_eventOverflow;
+		// update stats of the game thread while the network thread runs
+		NetUpdateStats m_gameUpdateStats;
 		// send&receive buffers
 		uint8_t* m_recvBuffer;
 		uint8_t* m_sendBuffer;
+		// where lost packets are rebuilt
+		uint8_t* m_fecBuffer;
+		// reused for the handle notifications
+		std::vector<uint32_t> m_deliveredHandles;
+		std::vector<uint32_t> m_lostHandles;
+		// reused for the transfer notifications
+		std::vector<BulkTransferProgress> m_transferProgress;
+		std::vector<uint8_t> m_transferData;
+		// reused for the channeled messages ready to process
+		std::vector<std::unique_ptr<Message>> m_channelReady;
 
 		// debugging
 		FastRand m_rng;
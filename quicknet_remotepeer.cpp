@@ -21,166 +21,1527 @@
 // EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <sstream>
+#include <algorithm>
 #include "quicknet_remotepeer.h"
+#include "quicknet_packet.h"
 #include "quicknet_messageslookup.h"
 
 namespace quicknet
 {
-	RemotePeer::RemotePeer(quicknet::Address address)
+	// all the times are in microseconds
+	// retransmission timeout limits and the value used before any RTT sample
+	static const uint32_t s_minimumRTO = 50 * 1000;
+	static const uint32_t s_maximumRTO = 2000 * 1000;
+	static const uint32_t s_initialRTO = 200 * 1000;
+	// how many newer acked sequences before resending a reliable without waiting for its timeout
+	static const uint32_t s_fastRetransmitThreshold = 3;
+	// unacked copies of each redundant message kind sent along every packet
+	static const uint8_t s_defaultRedundancy = 3;
+	// the ack bits only cover this many sequences back
+	static const uint16_t s_ackWindow = 32;
+	// path MTU discovery starts from a size any path should carry (IPv6 minimum MTU minus headers, as QUIC does)
+	static const uint32_t s_basePacketSize = 1200;
+	static const uint32_t s_minimumDatagramSize = 512;
+	// biggest UDP payload over IPv4
+	static const uint32_t s_maximumDatagramSize = 65507;
+	// sizes are confirmed within this many bytes
+	static const uint32_t s_probeGranularity = 32;
+	// a size is given up after this many unacked probes
+	static const uint32_t s_maximumProbeAttempts = 3;
+	// once done, the search for bigger sizes starts again after this long, in case the path changed
+	static const uint64_t s_probeRaiseTime = 600 * 1000 * 1000;
+	// this many lost packets above the base size in a row means the path no longer carries them
+	static const uint32_t s_blackHoleLosses = 4;
+	// bytes per send tick, 64 KB every 50 ms is above 1 MB/s
+	static const uint32_t s_defaultSendBudget = 64 * 1024;
+	// what a remote peer can queue by default, room for a level load burst
+	// reliables are left unlimited, the congestion window already keeps the unacked ones in check
+	static const uint32_t s_defaultQueueBytes = 4 * 1024 * 1024;
+	static const uint32_t s_defaultQueueMessages = 128 * 1024;
+	static const uint32_t s_defaultReliableLimit = 0;
+	// an automatic send tier goes one lower after this long without the game sending anything
+	static const uint64_t s_tierIdleTime = 1000 * 1000;
+	// packets are paced a bit faster than the window over the RTT, so the window can still grow
+	static const uint64_t s_pacingGainPercent = 125;
+	// the minimum RTT is forgotten after this long, in case the route changed
+	static const uint64_t s_minRTTWindow = 10 * 1000 * 1000;
+	// extra time a packet gets over the RTT to arrive after a newer one (out of 8 RTTs)
+	static const uint32_t s_reorderWindowEighths = 2;
+	// packet timestamps count tenths of a millisecond and wrap every 6.5 seconds, samples or hold times above this are garbage
+	static const uint64_t s_timestampUnit = 100;
+	static const uint16_t s_maximumTimestampDelta = 20000;
+	// bulk transfers leave at least this much of every round to the game traffic
+	static const uint8_t s_defaultBulkShare = 50;
+	// received packets before an ack goes back on its own
+	static const uint8_t s_defaultAckFrequency = 2;
+	// memory for the fragmented messages being put together, a bigger one is dropped
+	static const uint32_t s_defaultReassemblyLimit = 4 * 1024 * 1024;
+	// a fragmented message is dropped if no piece arrives in this long
+	static const uint64_t s_reassemblyTimeout = 5 * 1000 * 1000;
+	// bytes a channel of weight 1 gets on every turn
+	static const int32_t s_channelQuantum = 512;
+	// a reliable ordered channel sends at most this many messages from its oldest unacked one, so the receiver holds no more early ones
+	static const uint16_t s_channelWindow = 1024;
+	// how long messages with a deadline can overtake a queued one without it
+	static const uint64_t s_undatedGrace = 100 * 1000;
+
+	RemotePeer::RemotePeer(quicknet::Address address, uint64_t now)
 		: m_address(address)
 		, m_assignedID(0xFF)
 		, m_state(NetPeerState::Disconnected)
 		, m_ping(0)
 		, m_rtt(0)
+		, m_rttVariance(0)
+		, m_rto(s_initialRTO)
+		, m_minRTT(0)
+		, m_minRTTTime(0)
 		, m_sequenceIn(0)
 		, m_sequenceOut(1)
 		, m_sequenceRound(false)
 		, m_seqtrackReceived()
-		, m_pendingMessages()
+		, m_seqtrackSent()
+		, m_remoteTimestamp(0)
+		, m_remoteTimestampTime(0)
+		, m_lastAckedSequence(0)
+		, m_sendBudget(s_defaultSendBudget)
+		, m_packetSize(s_basePacketSize)
+		, m_datagramCeiling(s_maximumDatagramSize)
+		, m_probeLow(s_basePacketSize)
+		, m_probeHigh(s_maximumDatagramSize)
+		, m_probeSize(0)
+		, m_probeSequence(0)
+		, m_probeSendTime(0)
+		, m_probeAttempts(0)
+		, m_probing(true)
+		, m_nextSearchTime(0)
+		, m_bigPacketLosses(0)
+		, m_nextRound(0)
+		, m_roundOpen(false)
+		, m_roundBudget(0)
+		, m_roundBulkBudget(0)
+		, m_nextPacketTime(0)
+		, m_sendMode(NetSendMode::Batched)
+		, m_coalesceWindow(0)
+		, m_roundTime(0)
+		, m_sendTier(NetSendTier::Full)
+		, m_automaticTier(false)
+		, m_lastActivity(now)
+		, m_queueByteLimit(s_defaultQueueBytes)
+		, m_queueMessageLimit(s_defaultQueueMessages)
+		, m_reliableLimit(s_defaultReliableLimit)
+		, m_queuePolicy(NetQueuePolicy::DropOldest)
+		, m_queueDropCount(0)
+		, m_queueRejectCount(0)
+		, m_supersededCount(0)
+		, m_egressWeight(1)
+		, m_egressDeficit(0)
+		, m_egressDeferred(false)
+		, m_egressLate(false)
+		, m_congestionController()
+		, m_sentPackets()
+		, m_bytesInFlight(0)
+		, m_packetLoss(0.0f)
+		, m_channels()
+		, m_pendingCount(0)
+		, m_pendingBytes(0)
+		, m_firstPendingTime(0)
+		, m_pendingReliables(0)
+		, m_channelTurn(0)
+		, m_incomingChannels()
 		, m_reliableMessages()
-		, m_lastAckTime(Utils::GetElapsedMilliseconds())
-		, m_lastMessageTime(Utils::GetElapsedMilliseconds())
+		, m_reliableDue()
+		, m_reliableReady()
+		, m_redundantMessages()
+		, m_redundancy(s_defaultRedundancy)
+		, m_bulkSender()
+		, m_bulkReceiver()
+		, m_bulkShare(s_defaultBulkShare)
+		, m_seqtrackHandles()
+		, m_deliveredHandles()
+		, m_lostHandles()
+		, m_fragmentHandles()
+		, m_fragmentIDOut(0)
+		, m_fragmentAssemblies()
+		, m_reassemblyBytes(0)
+		, m_reassemblyLimit(s_defaultReassemblyLimit)
+		, m_ackFrequency(s_defaultAckFrequency)
+		, m_unackedPackets(0)
+		, m_unackedSequences()
+		, m_firstUnackedTime(0)
+		, m_uncoveredAckTime(0)
+		, m_lastAckTime(now)
+		, m_lastMessageTime(now)
 		, m_lastSend(0)
+		, m_fecEnabled(false)
+		, m_fecEncoder()
+		, m_fecDecoder()
+		, m_resendCount(0)
+		, m_fastResendCount(0)
+		, m_deadlineDropCount(0)
+		, m_bytesSent(0)
+		, m_bytesReceived(0)
+		, m_packetsSent(0)
+		, m_packetsReceived(0)
 	{
+		outgoingChannel(0);
 	}
 
 	RemotePeer::~RemotePeer()
 	{
 	}
 
-	void RemotePeer::EnqueueMessage(std::unique_ptr<Message> message)
+	void RemotePeer::EnqueueMessage(std::unique_ptr<Message> message, uint64_t now)
+	{
+		OutgoingChannel& channel = outgoingChannel(message->m_channel);
+		// the receiver of a reliable ordered channel waits for every message, dropping one at its deadline would stall it for good
+		if (message->m_channel != 0 && channel.m_mode == NetChannelMode::ReliableOrdered)
+		{
+			message->m_deadline = 0;
+		}
+		message->m_queuedReliable = flagCheck(ChannelFlags(message->m_channel, message->GenerateHeader().m_flags), s_flagReliable);
+		if (message->m_key != 0 && supersede(channel, message)) { return; }
+
+		std::deque<std::unique_ptr<Message>>& pending = channel.m_pending;
+		if (m_pendingCount == 0)
+		{
+			m_firstPendingTime = now;
+		}
+		m_pendingCount++;
+		m_pendingBytes += message->WireSize();
+		m_pendingReliables += isUnreliable(message.get()) ? 0 : 1;
+
+		// earliest deadline first, messages without one get a grace period so a steady stream of deadlines doesnt starve them
+		message->m_sendBy = (message->m_deadline != 0) ? message->m_deadline : (now + s_undatedGrace);
+		auto it = pending.end();
+		while (it != pending.begin() && (*(it - 1))->m_sendBy > message->m_sendBy)
+		{
+			it--;
+		}
+		pending.insert(it, std::move(message));
+	}
+
+	void RemotePeer::SetQueueLimits(uint32_t bytes, uint32_t messages, uint32_t reliables, NetQueuePolicy policy)
 	{
-		m_pendingMessages.push_back(std::move(message));
+		m_queueByteLimit = bytes;
+		m_queueMessageLimit = messages;
+		m_reliableLimit = reliables;
+		m_queuePolicy = policy;
 	}
 
-	void RemotePeer::RequeueMessage(std::unique_ptr<Message> message)
+	bool RemotePeer::MakeRoom(const Message* message, uint32_t bytes, uint32_t count, bool reliable)
 	{
-		if (!message->m_header.IsReliable()) { return; }
+		// the queued one with the same key goes when this one is queued (fragmented ones ignore the key)
+		const Message* replaced = (message->m_key != 0 && count == 1) ? queuedWithKey(message->m_channel, message->m_key) : nullptr;
+		if (replaced != nullptr)
+		{
+			bytes = (bytes > replaced->WireSize()) ? (bytes - replaced->WireSize()) : 0;
+			count = 0;
+			reliable = reliable && !replaced->m_queuedReliable;
+		}
+
+		// a peer that doesnt ack its reliables gets no more of them (queued ones count too), and some can never fit
+		bool fits = !(reliable && m_reliableLimit != 0 && m_reliableMessages.size() + m_pendingReliables + count > m_reliableLimit);
+		fits = fits && (m_queueByteLimit == 0 || bytes <= m_queueByteLimit) && (m_queueMessageLimit == 0 || count <= m_queueMessageLimit);
+
+		while (fits && ((m_queueByteLimit != 0 && m_pendingBytes + bytes > m_queueByteLimit) ||
+			(m_queueMessageLimit != 0 && m_pendingCount + count > m_queueMessageLimit)))
+		{
+			fits = (m_queuePolicy == NetQueuePolicy::DropOldest) && dropOldestUnreliable(replaced);
+		}
+
+		if (!fits)
+		{
+			m_queueRejectCount++;
+		}
+		return fits;
+	}
 
-		// set the last send timestamp
-		m_seqtrackSent[message->m_header.m_sequence] = Utils::GetElapsedMilliseconds();
+	const Message* RemotePeer::queuedWithKey(uint8_t channel, uint32_t key) const
+	{
+		if (channel >= m_channels.size()) { return nullptr; }
 
-		// put it on the back so we rotate the messages
-		// since we are sending one per message @ 20/s
-		m_reliableMessages.push_back(std::move(message));
+		const std::deque<std::unique_ptr<Message>>& pending = m_channels[channel].m_pending;
+		auto it = std::find_if(pending.begin(), pending.end(), [key](const std::unique_ptr<Message>& queued) { return queued->m_key == key; });
+		return (it != pending.end()) ? (*it).get() : nullptr;
 	}
 
-	std::unique_ptr<Message> RemotePeer::DequeueMessage()
+	bool RemotePeer::supersede(OutgoingChannel& channel, std::unique_ptr<Message>& message)
 	{
-		if (m_pendingMessages.empty()) { return nullptr; }
+		// unacked redundant copies of an older one would only resend stale data
+		for (auto it = m_redundantMessages.begin(); it != m_redundantMessages.end();)
+		{
+			bool stale = ((*it)->m_key == message->m_key) && ((*it)->m_channel == message->m_channel);
+			it = stale ? m_redundantMessages.erase(it) : (it + 1);
+		}
 
-		std::unique_ptr<Message> message = std::move(m_pendingMessages.front());
-		m_pendingMessages.pop_front();
+		auto it = std::find_if(channel.m_pending.begin(), channel.m_pending.end(),
+			[&message](const std::unique_ptr<Message>& queued) { return queued->m_key == message->m_key; });
+		if (it == channel.m_pending.end()) { return false; }
 
-		return message;
+		// it never went out, so it was lost
+		if ((*it)->m_handle != 0)
+		{
+			resolveHandle((*it)->m_handle, false);
+		}
+		m_pendingBytes -= (*it)->WireSize();
+		m_pendingReliables -= isUnreliable((*it).get()) ? 0 : 1;
+		m_supersededCount++;
+
+		// in place it keeps the turn of the old one, unless that would break the deadline order
+		if (message->m_deadline == 0 && (*it)->m_deadline == 0)
+		{
+			message->m_sendBy = (*it)->m_sendBy;
+			m_pendingBytes += message->WireSize();
+			m_pendingReliables += isUnreliable(message.get()) ? 0 : 1;
+			*it = std::move(message);
+			return true;
+		}
+
+		channel.m_pending.erase(it);
+		m_pendingCount--;
+		return false;
 	}
 
-	std::unique_ptr<Message> RemotePeer::DequeueReliableMessage()
+	bool RemotePeer::isUnreliable(Message* message) const
 	{
-		if (m_reliableMessages.empty()) { return nullptr; }
+		return !message->m_queuedReliable;
+	}
 
-		std::unique_ptr<Message> message = std::move(m_reliableMessages.front());
-		m_reliableMessages.pop_front();
+	bool RemotePeer::isChannelReady(uint8_t channel, uint32_t maxSize) const
+	{
+		const OutgoingChannel& outgoing = m_channels[channel];
+		if (outgoing.m_pending.empty() || outgoing.m_pending.front()->WireSize() > maxSize) { return false; }
 
-		return message;
+		return channel == 0 || outgoing.m_mode != NetChannelMode::ReliableOrdered || outgoing.m_unacked.size() < s_channelWindow;
 	}
 
-	void RemotePeer::UpdateRTT(uint32_t milliseconds)
+	void RemotePeer::releaseChannelSequence(const MessageHeader& header)
 	{
-		m_ping = milliseconds / 2;
-		m_rtt = (m_rtt == 0) ? milliseconds : (((m_rtt * 90) + (milliseconds * 10)) / 100);
+		if (!header.IsChanneled() || header.m_channel >= m_channels.size()) { return; }
 
-#if QUICKNET_VERBOSE
-		std::ostringstream ss;
-		ss << "Peer " << (uint32_t)m_assignedID << " current RTT: " << RTT() << " Ping: " << Ping();
-		Log::Info(ss.str());
-#endif
+		OutgoingChannel& channel = m_channels[header.m_channel];
+		uint16_t index = header.m_channelSequence - channel.m_unackedBase;
+		if (index >= channel.m_unacked.size()) { return; }
+
+		channel.m_unacked[index] = true;
+		while (!channel.m_unacked.empty() && channel.m_unacked.front())
+		{
+			channel.m_unacked.pop_front();
+			channel.m_unackedBase++;
+		}
 	}
 
-	uint32_t RemotePeer::GetAckBits()
+	bool RemotePeer::dropOldestUnreliable(const Message* keep)
 	{
-		uint32_t bits = 0x00;
-		uint16_t first = CurrentSequenceIn() - 1;
-		for (uint16_t i = 0; i < 32; i++)
+		OutgoingChannel* lowest = nullptr;
+		std::deque<std::unique_ptr<Message>>::iterator oldest;
+		for (OutgoingChannel& channel : m_channels)
 		{
-			uint16_t current = first - i;
-			uint32_t round = m_sequenceRound;
+			if (lowest != nullptr && channel.m_priority >= lowest->m_priority) { continue; }
 
-			auto it = m_seqtrackReceived.find(current);
-			if (it != m_seqtrackReceived.end())
+			for (auto it = channel.m_pending.begin(); it != channel.m_pending.end(); it++)
 			{
-				if (current > first) { --round; }
-				if (it->second.m_round == round)
+				if (isUnreliable((*it).get()) && (*it).get() != keep)
 				{
-					bitSet(&bits, i);
+					lowest = &channel;
+					oldest = it;
+					break;
 				}
 			}
 		}
-		return bits;
+		if (lowest == nullptr) { return false; }
+
+		// it never went out, so it was lost
+		if ((*oldest)->m_handle != 0)
+		{
+			resolveHandle((*oldest)->m_handle, false);
+		}
+		m_pendingBytes -= (*oldest)->WireSize();
+		m_pendingCount--;
+		lowest->m_pending.erase(oldest);
+		m_queueDropCount++;
+		return true;
 	}
 
-	void RemotePeer::ProcessAckBits(uint16_t sequence, uint32_t ackbits)
+	uint32_t RemotePeer::HeldBytes() const
 	{
-		// check the ack-pending messages and remove those that match the ack sequences
+		uint64_t bytes = (uint64_t)m_pendingBytes + m_reassemblyBytes;
+		for (const auto& reliable : m_reliableMessages)
+		{
+			bytes += reliable.second->WireSize();
+		}
+		for (const std::unique_ptr<Message>& message : m_redundantMessages)
+		{
+			bytes += message->WireSize();
+		}
+		return (bytes > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)bytes;
+	}
 
-		// first the base sequence
-		for (auto it = m_reliableMessages.begin(); it != m_reliableMessages.end(); it++)
+	void RemotePeer::RequeueMessage(std::unique_ptr<Message> message, uint64_t now)
+	{
+		if (!message->m_header.IsReliable())
 		{
-			if ((*it)->m_header.m_sequence == sequence)
+			if (!message->m_header.IsRedundant() || m_redundancy == 0) { return; }
+
+			uint8_t id = message->m_header.m_messageID;
+			uint32_t key = message->m_key;
+			m_redundantMessages.push_back(std::move(message));
+
+			// keep only the newest copies of this kind (and key, each one is its own)
+			uint32_t copies = 0;
+			auto oldest = m_redundantMessages.end();
+			for (auto it = m_redundantMessages.begin(); it != m_redundantMessages.end(); it++)
 			{
-#if QUICKNET_VERBOSE
-				Log::Info("ACKS: acked reliable sequence found. deleting");
-#endif
-				// first update the RTT
+				if ((*it)->m_header.m_messageID != id || (*it)->m_key != key) { continue; }
+
+				copies++;
+				if (oldest == m_redundantMessages.end() || IsSequenceNewer((*oldest)->m_header.m_sequence, (*it)->m_header.m_sequence))
 				{
-					auto time = m_seqtrackSent.find(sequence);
-					if (time != m_seqtrackSent.end())
-					{
-						uint32_t milliseconds = (uint32_t)(Utils::GetElapsedMilliseconds() - time->second);
-						UpdateRTT(milliseconds);
-					}
-					m_seqtrackSent.erase(sequence);
+					oldest = it;
 				}
-				m_reliableMessages.erase(it);
-				// once deleted we can stop searching
-				break;
 			}
+			if (copies > m_redundancy)
+			{
+				m_redundantMessages.erase(oldest);
+			}
+			return;
 		}
 
-		uint16_t first = sequence - 1;
-		for (uint16_t i = 0; i < 32; i++)
+		uint16_t sequence = message->m_header.m_sequence;
+
+		auto it = m_seqtrackSent.find(sequence);
+		if (it == m_seqtrackSent.end())
 		{
-			// if the bit is set, then the message is acknowledged
-			if (bitCheck(ackbits, i))
+			// first time it goes out, use the current timeout
+			ReliableTrackingEntry entry;
+			entry.m_sendTime = now;
+			entry.m_timeout = m_rto;
+			entry.m_resends = 0;
+			entry.m_skipped = 0;
+			m_seqtrackSent[sequence] = entry;
+			// the ones that were never queued, like bulk chunks, get the grace of the undated ones
+			if (message->m_sendBy == 0)
+			{
+				message->m_sendBy = now + s_undatedGrace;
+			}
+		}
+		else
+		{
+			ReliableTrackingEntry& entry = it->second;
+			if (entry.m_skipped >= s_fastRetransmitThreshold)
+			{
+				// fast retransmit keeps the timeout as it is
+				m_fastResendCount++;
+			}
+			else
+			{
+				// exponential backoff
+				entry.m_timeout = (entry.m_timeout * 2 > s_maximumRTO) ? s_maximumRTO : (entry.m_timeout * 2);
+			}
+			entry.m_sendTime = now;
+			entry.m_skipped = 0;
+			entry.m_resends++;
+			m_resendCount++;
+		}
+
+		// kept in order of when its due again, so the next resend is always the first one
+		m_reliableDue.insert(std::make_pair(reliableDueTime(m_seqtrackSent[sequence]), sequence));
+		m_reliableMessages[sequence] = std::move(message);
+	}
+
+	std::unique_ptr<Message> RemotePeer::DequeueMessage(uint32_t maxSize, uint64_t now)
+	{
+		if (m_pendingCount == 0) { return nullptr; }
+
+		// expired ones are always at the front
+		// only the highest priority with something that fits goes, so a big message doesnt block the other channels
+		bool found = false;
+		uint8_t priority = 0;
+		for (size_t number = 0; number < m_channels.size(); number++)
+		{
+			OutgoingChannel& channel = m_channels[number];
+			while (!channel.m_pending.empty() && dropIfExpired(channel.m_pending.front().get(), now))
+			{
+				m_pendingBytes -= channel.m_pending.front()->WireSize();
+				m_pendingReliables -= isUnreliable(channel.m_pending.front().get()) ? 0 : 1;
+				channel.m_pending.pop_front();
+				m_pendingCount--;
+			}
+			if (channel.m_pending.empty())
+			{
+				channel.m_deficit = 0;
+				continue;
+			}
+
+			if (!isChannelReady((uint8_t)number, maxSize)) { continue; }
+			if (!found || channel.m_priority > priority)
+			{
+				priority = channel.m_priority;
+				found = true;
+			}
+		}
+		if (!found) { return nullptr; }
+
+		// deficit round robin between the channels of that priority, each turn gives them bytes by weight
+		while (true)
+		{
+			OutgoingChannel& channel = m_channels[m_channelTurn];
+			if (channel.m_priority == priority && isChannelReady(m_channelTurn, maxSize))
 			{
-				uint16_t current = first - i;
-				// search the sequence and remove the message
-				for (auto it = m_reliableMessages.begin(); it != m_reliableMessages.end(); it++)
+				int32_t size = (int32_t)channel.m_pending.front()->WireSize();
+				if (channel.m_deficit >= size)
 				{
-					if ((*it)->m_header.m_sequence == current)
+					std::unique_ptr<Message> message = std::move(channel.m_pending.front());
+					channel.m_pending.pop_front();
+					m_pendingCount--;
+					m_pendingBytes -= (uint32_t)size;
+					m_pendingReliables -= isUnreliable(message.get()) ? 0 : 1;
+
+					// it takes the next channel sequence when the packet is built
+					if (m_channelTurn != 0 && channel.m_mode == NetChannelMode::ReliableOrdered)
 					{
-#if QUICKNET_VERBOSE
-						Log::Info("ACKS: acked reliable sequence found. deleting");
-#endif
-						// first update the RTT
+						if (channel.m_unacked.empty())
 						{
-							auto time = m_seqtrackSent.find(current);
-							if (time != m_seqtrackSent.end())
-							{
-								uint32_t milliseconds = (uint32_t)(Utils::GetElapsedMilliseconds() - time->second);
-								UpdateRTT(milliseconds);
-							}
-							m_seqtrackSent.erase(current);
+							channel.m_unackedBase = channel.m_sequence;
 						}
-						m_reliableMessages.erase(it);
-						// once deleted we can stop searching
-						break;
+						channel.m_unacked.push_back(false);
 					}
+
+					channel.m_deficit = channel.m_pending.empty() ? 0 : (channel.m_deficit - size);
+					return message;
 				}
+				channel.m_deficit += s_channelQuantum * channel.m_weight;
+			}
+			m_channelTurn = (uint8_t)((m_channelTurn + 1) % m_channels.size());
+		}
+	}
+
+	std::unique_ptr<Message> RemotePeer::DequeueReliableMessage(uint32_t maxSize, uint64_t now)
+	{
+		// the ones that came due go in the send order, earliest deadline first like the queued ones
+		for (auto due = m_reliableDue.begin(); due != m_reliableDue.end() && due->first <= now; due = m_reliableDue.erase(due))
+		{
+			m_reliableReady.insert(std::make_pair(m_reliableMessages[due->second]->m_sendBy, due->second));
+		}
+
+		// only the due ones are looked at, the ones that dont fit are left for the next packet
+		for (auto ready = m_reliableReady.begin(); ready != m_reliableReady.end();)
+		{
+			uint16_t sequence = ready->second;
+			auto it = m_reliableMessages.find(sequence);
+
+			// stop resending the expired ones
+			if (dropIfExpired(it->second.get(), now))
+			{
+				releaseChannelSequence(it->second->m_header);
+				m_seqtrackSent.erase(sequence);
+				m_reliableMessages.erase(it);
+				ready = m_reliableReady.erase(ready);
+				continue;
+			}
+			if (it->second->WireSize() > maxSize)
+			{
+				ready++;
+				continue;
+			}
+
+			std::unique_ptr<Message> message = std::move(it->second);
+			m_reliableMessages.erase(it);
+			m_reliableReady.erase(ready);
+			return message;
+		}
+		return nullptr;
+	}
+
+	std::unique_ptr<Message> RemotePeer::DequeueRedundantMessage(uint32_t maxSize, uint64_t now)
+	{
+		for (auto it = m_redundantMessages.begin(); it != m_redundantMessages.end();)
+		{
+			// once out of the ack window it can't be acked anymore, and its too old to matter
+			// the same if it expired, but it already went out at least once so it doesn't count as dropped
+			bool expired = ((*it)->m_deadline != 0) && (now >= (*it)->m_deadline);
+			if ((uint16_t)(m_sequenceOut - (*it)->m_header.m_sequence) > s_ackWindow || expired)
+			{
+				it = m_redundantMessages.erase(it);
+				continue;
+			}
+
+			if ((*it)->WireSize() <= maxSize)
+			{
+				std::unique_ptr<Message> message = std::move(*it);
+				m_redundantMessages.erase(it);
+				return message;
+			}
+			it++;
+		}
+
+		return nullptr;
+	}
+
+	std::unique_ptr<Message> RemotePeer::DequeueBulkChunk(uint32_t maxSize)
+	{
+		if (m_roundBulkBudget == 0) { return nullptr; }
+
+		uint32_t limit = (maxSize < m_roundBulkBudget) ? maxSize : m_roundBulkBudget;
+		std::unique_ptr<MessageBulkChunk> chunk = m_bulkSender.NextChunk(limit);
+		if (!chunk)
+		{
+			// the rest of the share is too small for a chunk, bulk is done for this round
+			if (limit == m_roundBulkBudget && m_bulkSender.HasChunkReady())
+			{
+				m_roundBulkBudget = 0;
+			}
+			return nullptr;
+		}
+
+		m_roundBulkBudget -= chunk->WireSize();
+		return chunk;
+	}
+
+	void RemotePeer::SetChannel(uint8_t channel, NetChannelMode mode, uint8_t priority, uint16_t weight)
+	{
+		OutgoingChannel& outgoing = outgoingChannel(channel);
+		// the window only follows what is sent in the reliable ordered mode
+		if (outgoing.m_mode != mode)
+		{
+			outgoing.m_unacked.clear();
+		}
+		// the queued reliables are recounted under the new mode
+		for (const std::unique_ptr<Message>& message : outgoing.m_pending)
+		{
+			m_pendingReliables -= isUnreliable(message.get()) ? 0 : 1;
+		}
+		outgoing.m_mode = mode;
+		for (const std::unique_ptr<Message>& message : outgoing.m_pending)
+		{
+			message->m_queuedReliable = flagCheck(ChannelFlags(message->m_channel, message->GenerateHeader().m_flags), s_flagReliable);
+			m_pendingReliables += isUnreliable(message.get()) ? 0 : 1;
+		}
+		outgoing.m_priority = priority;
+		outgoing.m_weight = (weight == 0) ? 1 : weight;
+	}
+
+	uint8_t RemotePeer::ChannelFlags(uint8_t channel, uint8_t flags) const
+	{
+		if (channel == 0) { return flags; }
+
+		// channels unknown here are sent with the default mode
+		NetChannelMode mode = (channel < m_channels.size()) ? m_channels[channel].m_mode : NetChannelMode::ReliableOrdered;
+		flags &= ~(s_flagReliable | s_flagOrdered | s_flagUnsequenced);
+		flags |= s_flagChannel;
+		switch (mode)
+		{
+		case NetChannelMode::Sequenced:
+			flags |= s_flagOrdered;
+			break;
+		case NetChannelMode::ReliableOrdered:
+			flags |= s_flagReliable | s_flagOrdered;
+			break;
+		case NetChannelMode::ReliableUnordered:
+			flags |= s_flagReliable;
+			break;
+		default:
+			break;
+		}
+		return flags;
+	}
+
+	void RemotePeer::ApplyChannel(MessageHeader& header, uint8_t channel)
+	{
+		header.m_flags = ChannelFlags(channel, header.m_flags);
+		header.m_channel = channel;
+		header.m_channelSequence = outgoingChannel(channel).m_sequence++;
+	}
+
+	void RemotePeer::ReceiveOnChannel(std::unique_ptr<Message> message, std::vector<std::unique_ptr<Message>>& ready)
+	{
+		const MessageHeader& header = message->m_header;
+		if (!header.IsOrdered())
+		{
+			ready.push_back(std::move(message));
+			return;
+		}
+
+		// channel sequences start from 0 with the connection
+		auto found = m_incomingChannels.find(header.m_channel);
+		if (found == m_incomingChannels.end())
+		{
+			IncomingChannel incoming;
+			incoming.m_nextSequence = 0;
+			found = m_incomingChannels.emplace(header.m_channel, std::move(incoming)).first;
+		}
+		IncomingChannel& channel = found->second;
+		uint16_t sequence = header.m_channelSequence;
+		bool next = (sequence == channel.m_nextSequence);
+		bool newer = IsSequenceNewer(sequence, channel.m_nextSequence);
+
+		// sequenced ones only go if nothing newer went before
+		if (!header.IsReliable())
+		{
+			if (next || newer)
+			{
+				channel.m_nextSequence = sequence + 1;
+				ready.push_back(std::move(message));
+			}
+			return;
+		}
+
+		// older ones are copies of something already delivered, the sender never goes a window ahead of the next one
+		if (newer)
+		{
+			if ((uint16_t)(sequence - channel.m_nextSequence) < s_channelWindow)
+			{
+				channel.m_early.emplace(sequence, std::move(message));
+			}
+			return;
+		}
+		if (!next) { return; }
+
+		ready.push_back(std::move(message));
+		channel.m_nextSequence++;
+
+		// release the ones that were waiting for it
+		auto waiting = channel.m_early.find(channel.m_nextSequence);
+		while (waiting != channel.m_early.end())
+		{
+			ready.push_back(std::move(waiting->second));
+			channel.m_early.erase(waiting);
+			channel.m_nextSequence++;
+			waiting = channel.m_early.find(channel.m_nextSequence);
+		}
+	}
+
+	OutgoingChannel& RemotePeer::outgoingChannel(uint8_t channel)
+	{
+		while (m_channels.size() <= channel)
+		{
+			OutgoingChannel outgoing;
+			outgoing.m_mode = NetChannelMode::ReliableOrdered;
+			outgoing.m_priority = 0;
+			outgoing.m_weight = 1;
+			outgoing.m_deficit = 0;
+			outgoing.m_sequence = 0;
+			outgoing.m_unackedBase = 0;
+			m_channels.push_back(std::move(outgoing));
+		}
+		return m_channels[channel];
+	}
+
+	bool RemotePeer::HaveReliableMessagesDue(uint64_t now)
+	{
+		return !m_reliableReady.empty() || (!m_reliableDue.empty() && m_reliableDue.begin()->first <= now);
+	}
+
+	uint16_t RemotePeer::LocalTimestamp(uint64_t now) const
+	{
+		// 0 is reserved for no timestamp, being one unit off doesnt matter
+		uint16_t timestamp = (uint16_t)(now / s_timestampUnit);
+		return (timestamp == 0) ? 1 : timestamp;
+	}
+
+	uint16_t RemotePeer::EchoTimestamp(uint64_t now) const
+	{
+		if (m_remoteTimestamp == 0) { return 0; }
+
+		// send it back moved forward by the time we held it
+		uint64_t held = (now - m_remoteTimestampTime) / s_timestampUnit;
+		if (held > s_maximumTimestampDelta) { return 0; }
+
+		uint16_t echo = (uint16_t)(m_remoteTimestamp + held);
+		return (echo == 0) ? 1 : echo;
+	}
+
+	void RemotePeer::ProcessTimestamps(uint16_t timestamp, uint16_t echoTimestamp, uint64_t now)
+	{
+		if (timestamp != 0)
+		{
+			m_remoteTimestamp = timestamp;
+			m_remoteTimestampTime = now;
+		}
+
+		if (echoTimestamp != 0)
+		{
+			uint16_t units = (uint16_t)(LocalTimestamp(now) - echoTimestamp);
+			if (units <= s_maximumTimestampDelta)
+			{
+				UpdateRTT((uint32_t)(units * s_timestampUnit), now);
+			}
+		}
+	}
+
+	void RemotePeer::AckablePacketReceived(uint64_t now)
+	{
+		if (m_unackedPackets == 0)
+		{
+			m_firstUnackedTime = now;
+		}
+		m_unackedPackets++;
+	}
+
+	bool RemotePeer::IsAckDue(uint64_t maxDelay, uint64_t now) const
+	{
+		if (m_unackedPackets == 0) { return false; }
+		if (m_unackedPackets >= m_ackFrequency) { return true; }
+
+		return (now - m_firstUnackedTime) >= maxDelay;
+	}
+
+	void RemotePeer::AcksSent(uint16_t sequence)
+	{
+		// the older acks dont cover the last packets
+		if (sequence == m_sequenceIn)
+		{
+			m_unackedPackets = 0;
+		}
+
+		for (uint32_t i = 0; i < m_unackedSequences.size();)
+		{
+			uint16_t pending = m_unackedSequences[i];
+			if (!IsSequenceNewer(pending, sequence) && (uint16_t)(sequence - pending) <= s_ackWindow)
+			{
+				m_unackedSequences[i] = m_unackedSequences.back();
+				m_unackedSequences.pop_back();
+				continue;
+			}
+			i++;
+		}
+	}
+
+	bool RemotePeer::UncoveredSequence(uint16_t& sequence)
+	{
+		bool found = false;
+		for (uint16_t pending : m_unackedSequences)
+		{
+			if ((uint16_t)(m_sequenceIn - pending) <= s_ackWindow) { continue; }
+
+			if (!found || IsSequenceNewer(pending, sequence))
+			{
+				sequence = pending;
+				found = true;
 			}
 		}
+		return found;
+	}
+
+	void RemotePeer::TrackHandle(uint16_t sequence, uint32_t handle, bool reliable)
+	{
+		m_seqtrackHandles[sequence] = { handle, reliable };
+	}
+
+	void RemotePeer::TrackFragmentedHandle(uint32_t handle, uint16_t count)
+	{
+		m_fragmentHandles[handle] = { count, false };
+	}
+
+	bool RemotePeer::TakeHandleNotifications(std::vector<uint32_t>& delivered, std::vector<uint32_t>& lost)
+	{
+		if (m_deliveredHandles.empty() && m_lostHandles.empty()) { return false; }
+
+		delivered.swap(m_deliveredHandles);
+		lost.swap(m_lostHandles);
+		m_deliveredHandles.clear();
+		m_lostHandles.clear();
+		return true;
+	}
 
-		UpdateLastAckTime();
+	void RemotePeer::LoseHandles()
+	{
+		for (OutgoingChannel& channel : m_channels)
+		{
+			for (const std::unique_ptr<Message>& message : channel.m_pending)
+			{
+				if (message->m_handle != 0)
+				{
+					resolveHandle(message->m_handle, false);
+				}
+			}
+		}
+		for (const std::pair<const uint16_t, HandleTrackingEntry>& entry : m_seqtrackHandles)
+		{
+			resolveHandle(entry.second.m_handle, false);
+		}
+		m_seqtrackHandles.clear();
+
+		// the pieces that never went out dont count down, so the ones not reported yet are reported now
+		for (const std::pair<const uint32_t, FragmentHandleEntry>& entry : m_fragmentHandles)
+		{
+			if (!entry.second.m_lost)
+			{
+				m_lostHandles.push_back(entry.first);
+			}
+		}
+		m_fragmentHandles.clear();
+	}
+
+	void RemotePeer::ackHandle(uint16_t sequence)
+	{
+		auto entry = m_seqtrackHandles.find(sequence);
+		if (entry == m_seqtrackHandles.end()) { return; }
+
+		resolveHandle(entry->second.m_handle, true);
+		m_seqtrackHandles.erase(entry);
+	}
+
+	void RemotePeer::resolveHandle(uint32_t handle, bool delivered)
+	{
+		auto entry = m_fragmentHandles.find(handle);
+		if (entry == m_fragmentHandles.end())
+		{
+			(delivered ? m_deliveredHandles : m_lostHandles).push_back(handle);
+			return;
+		}
+
+		// lost with the first lost piece, delivered once all of them are
+		if (!delivered && !entry->second.m_lost)
+		{
+			m_lostHandles.push_back(handle);
+			entry->second.m_lost = true;
+		}
+		if (--entry->second.m_remaining == 0)
+		{
+			if (!entry->second.m_lost)
+			{
+				m_deliveredHandles.push_back(handle);
+			}
+			m_fragmentHandles.erase(entry);
+		}
+	}
+
+	bool RemotePeer::dropIfExpired(const Message* message, uint64_t now)
+	{
+		if (message->m_deadline == 0 || now < message->m_deadline) { return false; }
+
+		if (message->m_handle != 0)
+		{
+			resolveHandle(message->m_handle, false);
+
+			// if it went out already it was tracked by sequence
+			auto entry = m_seqtrackHandles.find(message->m_header.m_sequence);
+			if (entry != m_seqtrackHandles.end() && entry->second.m_handle == message->m_handle)
+			{
+				m_seqtrackHandles.erase(entry);
+			}
+		}
+
+#if QUICKNET_VERBOSE
+		std::ostringstream ss;
+		ss << "Dropping " << message->Name() << " with sequence " << message->m_header.m_sequence << " because its deadline passed";
+		Log::Info(ss.str());
+#endif
+		m_deadlineDropCount++;
+		return true;
+	}
+
+	uint64_t RemotePeer::reliableDueTime(const ReliableTrackingEntry& entry) const
+	{
+		if (entry.m_skipped >= s_fastRetransmitThreshold) { return 0; }
+		return entry.m_sendTime + entry.m_timeout;
+	}
+
+	void RemotePeer::UpdateRTT(uint32_t microseconds, uint64_t now)
+	{
+		m_ping = microseconds / 2;
+
+		if (m_minRTT == 0 || microseconds <= m_minRTT || (now - m_minRTTTime) > s_minRTTWindow)
+		{
+			m_minRTT = (microseconds == 0) ? 1 : microseconds;
+			m_minRTTTime = now;
+		}
+
+		// Jacobson/Karels smoothing
+		if (m_rtt == 0)
+		{
+			m_rtt = microseconds;
+			m_rttVariance = microseconds / 2;
+		}
+		else
+		{
+			uint32_t delta = (m_rtt > microseconds) ? (m_rtt - microseconds) : (microseconds - m_rtt);
+			m_rttVariance = ((m_rttVariance * 3) + delta) / 4;
+			m_rtt = ((m_rtt * 7) + microseconds) / 8;
+		}
+
+		uint32_t rto = m_rtt + (m_rttVariance * 4);
+		m_rto = (rto < s_minimumRTO) ? s_minimumRTO : ((rto > s_maximumRTO) ? s_maximumRTO : rto);
+
+#if QUICKNET_VERBOSE
+		std::ostringstream ss;
+		ss << "Peer " << (uint32_t)m_assignedID << " current RTT: " << RTT() << " Ping: " << Ping() << " RTO: " << RTO();
+		Log::Info(ss.str());
+#endif
+	}
+
+	uint32_t RemotePeer::GetAckBits(uint16_t sequence)
+	{
+		uint32_t bits = 0x00;
+		uint16_t first = sequence - 1;
+		for (uint16_t i = 0; i < 32; i++)
+		{
+			uint16_t current = first - i;
+			uint32_t round = m_sequenceRound;
+
+			auto it = m_seqtrackReceived.find(current);
+			if (it != m_seqtrackReceived.end())
+			{
+				// from before the last overflow
+				if (current > CurrentSequenceIn()) { --round; }
+				if (it->second.m_round == round)
+				{
+					bitSet(&bits, i);
+				}
+			}
+		}
+		return bits;
+	}
+
+	void RemotePeer::ProcessAckBits(uint16_t sequence, uint32_t ackbits, uint64_t now)
+	{
+		// check the ack-pending messages and remove those that match the ack sequences
+
+		// first the base sequence
+		ackReliable(sequence);
+		ackRedundant(sequence);
+		ackHandle(sequence);
+		ackPacket(sequence, now);
+		ackMTUProbe(sequence, now);
+
+		uint16_t first = sequence - 1;
+		for (uint16_t i = 0; i < 32; i++)
+		{
+			// if the bit is set, then the message is acknowledged
+			if (bitCheck(ackbits, i))
+			{
+				ackReliable(first - i);
+				ackRedundant(first - i);
+				ackHandle(first - i);
+				ackPacket(first - i, now);
+				ackMTUProbe(first - i, now);
+			}
+		}
+
+		// if the remote got something newer, the reliables still pending behind it were probably lost
+		if (IsSequenceNewer(sequence, m_lastAckedSequence))
+		{
+			// sample the loss over the sequences this ack newly covers
+			if (m_lastAckedSequence != 0)
+			{
+				uint16_t covered = sequence - m_lastAckedSequence;
+				covered = (covered > 33) ? 33 : covered;
+
+				uint16_t acked = 1;
+				for (uint16_t i = 0; i < covered - 1; i++)
+				{
+					if (bitCheck(ackbits, i)) { acked++; }
+				}
+
+				float sample = (float)(covered - acked) / (float)covered;
+				m_packetLoss = (m_packetLoss * 0.875f) + (sample * 0.125f);
+			}
+
+			m_lastAckedSequence = sequence;
+			for (const auto& reliable : m_reliableMessages)
+			{
+				if (IsSequenceNewer(sequence, reliable.first))
+				{
+					auto time = m_seqtrackSent.find(reliable.first);
+					// only fast retransmit once, after that the timeout takes over
+					if (time != m_seqtrackSent.end() && time->second.m_resends == 0)
+					{
+						uint64_t dueTime = reliableDueTime(time->second);
+						time->second.m_skipped++;
+						// skipped enough times it moves to the front
+						if (reliableDueTime(time->second) != dueTime && m_reliableDue.erase(std::make_pair(dueTime, reliable.first)) != 0)
+						{
+							m_reliableDue.insert(std::make_pair(reliableDueTime(time->second), reliable.first));
+						}
+					}
+				}
+			}
+
+			// unreliables behind the ack window can't be acked anymore
+			for (auto it = m_seqtrackHandles.begin(); it != m_seqtrackHandles.end();)
+			{
+				if (!it->second.m_reliable && IsSequenceNewer(sequence, it->first) && (uint16_t)(sequence - it->first) > s_ackWindow)
+				{
+					resolveHandle(it->second.m_handle, false);
+					it = m_seqtrackHandles.erase(it);
+					continue;
+				}
+				it++;
+			}
+		}
+
+		markMissedPackets(sequence);
+		detectLostPackets(now);
+		UpdateLastAckTime(now);
+	}
+
+	void RemotePeer::UpdateSendRound(uint64_t now, uint64_t roundTime)
+	{
+		m_roundTime = roundTime;
+
+		// automatic tiers go down while the game has nothing for it (a transfer going on counts)
+		if (m_automaticTier)
+		{
+			if (m_bulkSender.HasChunkReady())
+			{
+				m_lastActivity = now;
+			}
+			uint64_t tier = (now - m_lastActivity) / s_tierIdleTime;
+			applySendTier((tier > NetSendTier::Quarter) ? NetSendTier::Quarter : (NetSendTier)tier, now);
+		}
+
+		// the budget comes back at the send rate whatever the mode
+		bool refilled = false;
+		if (now >= m_nextRound)
+		{
+			// with the bytes of the rounds it skips
+			uint64_t budget = (uint64_t)m_sendBudget * RoundDivisor();
+			m_roundBudget = (budget > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)budget;
+			m_roundBulkBudget = (uint32_t)(((uint64_t)m_roundBudget * m_bulkShare) / 100);
+			refilled = true;
+
+			// keep the phase even if some rounds were skipped
+			m_nextRound += roundTime * (((now - m_nextRound) / roundTime) + 1);
+			// the lower tiers spread over the ticks by ID, so they dont all send on the same one
+			while ((((m_nextRound / roundTime) + m_assignedID) % RoundDivisor()) != 0)
+			{
+				m_nextRound += roundTime;
+			}
+		}
+
+		// whatever was left of the last round goes in this one
+		switch (m_sendMode)
+		{
+		case NetSendMode::Immediate:
+			m_roundOpen = m_roundOpen || refilled || HaveMessagesPending();
+			break;
+		case NetSendMode::Coalesced:
+			m_roundOpen = m_roundOpen || isCoalescedReady(now);
+			break;
+		default:
+			m_roundOpen = m_roundOpen || refilled;
+			break;
+		}
+	}
+
+	void RemotePeer::SetSendTier(NetSendTier tier, uint64_t now)
+	{
+		m_automaticTier = (tier == NetSendTier::Automatic);
+		m_lastActivity = now;
+		applySendTier(m_automaticTier ? NetSendTier::Full : tier, now);
+	}
+
+	void RemotePeer::GameActivity(uint64_t now)
+	{
+		m_lastActivity = now;
+		if (m_automaticTier)
+		{
+			applySendTier(NetSendTier::Full, now);
+		}
+	}
+
+	void RemotePeer::applySendTier(NetSendTier tier, uint64_t now)
+	{
+		// going up, the rounds it was going to skip come back
+		if (tier < m_sendTier && m_roundTime != 0)
+		{
+			while (m_nextRound >= m_roundTime && (m_nextRound - m_roundTime) > now)
+			{
+				m_nextRound -= m_roundTime;
+			}
+		}
+		m_sendTier = tier;
+	}
+
+	bool RemotePeer::isCoalescedReady(uint64_t now)
+	{
+		// resends and transfers dont wait
+		if (HaveReliableMessagesDue(now) || HaveBulkChunksReady()) { return true; }
+		if (m_pendingCount == 0) { return false; }
+
+		return (PacketHeader::Size() + m_pendingBytes >= m_packetSize) || (now - m_firstPendingTime >= m_coalesceWindow);
+	}
+
+	void RemotePeer::PacePacket(uint32_t bytes, uint64_t roundTime, uint64_t earliest)
+	{
+		m_roundBudget = (bytes > m_roundBudget) ? 0 : (m_roundBudget - bytes);
+
+		uint64_t rate = PacingRate(roundTime);
+		m_nextPacketTime = ((m_nextPacketTime < earliest) ? earliest : m_nextPacketTime) + ((uint64_t)bytes * 1000 * 1000) / rate;
+	}
+
+	uint32_t RemotePeer::PacingRate(uint64_t roundTime) const
+	{
+		// the budget spread over the whole round
+		uint64_t rate = ((uint64_t)m_sendBudget * 1000 * 1000) / ((roundTime == 0) ? 1 : roundTime);
+
+		// and no faster than the window can be delivered in one RTT (with some margin to grow)
+		if (m_congestionController && m_rtt > 0)
+		{
+			uint64_t windowRate = ((uint64_t)m_congestionController->CongestionWindow() * 1000 * 1000 * s_pacingGainPercent) / ((uint64_t)m_rtt * 100);
+			rate = (windowRate < rate) ? windowRate : rate;
+		}
+
+		return (rate == 0) ? 1 : (uint32_t)((rate > 0xFFFFFFFF) ? 0xFFFFFFFF : rate);
+	}
+
+	void RemotePeer::SetCongestionController(std::unique_ptr<CongestionController> controller)
+	{
+		// the new one starts with nothing in flight
+		m_congestionController = std::move(controller);
+		if (m_congestionController)
+		{
+			m_congestionController->SetPacketSize(m_packetSize);
+		}
+		m_sentPackets.clear();
+		m_bytesInFlight = 0;
+	}
+
+	void RemotePeer::PacketSent(uint16_t sequence, uint32_t bytes, uint64_t now)
+	{
+		if (!m_congestionController) { return; }
+
+		m_sentPackets.push_back({ now, bytes, sequence, false });
+		m_bytesInFlight += bytes;
+		m_congestionController->OnPacketSent(bytes, now);
+	}
+
+	uint32_t RemotePeer::CongestionWindowRoom(uint64_t now)
+	{
+		if (!m_congestionController) { return 0xFFFFFFFF; }
+
+		// without acks coming the window would never open again
+		detectLostPackets(now);
+
+		// more packets than the ack bits cover could never all be acked
+		if (m_sentPackets.size() >= s_ackWindow) { return 0; }
+
+		uint32_t window = m_congestionController->CongestionWindow();
+		return (window > m_bytesInFlight) ? (window - m_bytesInFlight) : 0;
+	}
+
+	void RemotePeer::ackPacket(uint16_t sequence, uint64_t now)
+	{
+		// resent messages can make two packets share their newest sequence, any of them arriving is enough
+		for (auto it = m_sentPackets.begin(); it != m_sentPackets.end();)
+		{
+			if (it->m_sequence != sequence)
+			{
+				it++;
+				continue;
+			}
+
+			m_bytesInFlight -= it->m_bytes;
+			if (it->m_bytes > s_basePacketSize)
+			{
+				m_bigPacketLosses = 0;
+			}
+			m_congestionController->OnPacketAcked(it->m_bytes, (uint32_t)(now - it->m_sendTime), it->m_sendTime, now);
+			it = m_sentPackets.erase(it);
+		}
+	}
+
+	void RemotePeer::markMissedPackets(uint16_t sequence)
+	{
+		// the acked ones are gone already
+		for (SentPacketEntry& entry : m_sentPackets)
+		{
+			if (!IsSequenceNewer(entry.m_sequence, sequence) && (uint16_t)(sequence - entry.m_sequence) <= s_ackWindow)
+			{
+				entry.m_missed = true;
+			}
+		}
+	}
+
+	void RemotePeer::detectLostPackets(uint64_t now)
+	{
+		// missed ones get about an RTT more in case they were just reordered
+		uint32_t reorderTime = m_rtt + ((m_rtt * s_reorderWindowEighths) / 8);
+		for (auto it = m_sentPackets.begin(); it != m_sentPackets.end();)
+		{
+			bool lost = (it->m_missed && (now - it->m_sendTime) > reorderTime) || ((now - it->m_sendTime) > (m_rto * 2));
+			// with many messages per packet an ack may never cover it, we can't tell so it doesnt count as lost
+			bool unknown = !it->m_missed && IsSequenceNewer(m_lastAckedSequence, it->m_sequence) && ((uint16_t)(m_lastAckedSequence - it->m_sequence) > s_ackWindow);
+			if (!lost && !unknown)
+			{
+				it++;
+				continue;
+			}
+
+			m_bytesInFlight -= it->m_bytes;
+			if (lost)
+			{
+				m_congestionController->OnPacketLost(it->m_bytes, it->m_sendTime, now);
+				if (it->m_bytes > s_basePacketSize)
+				{
+					m_bigPacketLosses++;
+				}
+			}
+			it = m_sentPackets.erase(it);
+		}
+
+		checkBlackHole(now);
+	}
+
+	uint32_t RemotePeer::FallbackPacketSize() const
+	{
+		// black hole detection goes back to the base size, and the packets never go above the ceiling
+		return (m_datagramCeiling < s_basePacketSize) ? m_datagramCeiling : s_basePacketSize;
+	}
+
+	std::unique_ptr<Message> RemotePeer::AddFragment(const MessageFragment* fragment, uint64_t now)
+	{
+		uint16_t count = fragment->m_count;
+		uint32_t totalSize = fragment->m_totalSize;
+		if (count == 0 || fragment->m_index >= count || totalSize == 0 || fragment->m_messageID == MessageIDs::Fragment)
+		{
+			Log::Warn("Received an invalid fragment. Skipping");
+			return nullptr;
+		}
+
+		// every piece has the same size but the last one
+		uint32_t pieceSize = (totalSize + count - 1) / count;
+		uint32_t offset = fragment->m_index * pieceSize;
+		uint32_t length = (fragment->m_index == count - 1) ? (totalSize - offset) : pieceSize;
+		if (offset >= totalSize || fragment->m_data.size() != length)
+		{
+			Log::Warn("Received a fragment with the wrong size. Skipping");
+			return nullptr;
+		}
+
+		auto it = m_fragmentAssemblies.find(fragment->m_fragmentID);
+		if (it == m_fragmentAssemblies.end())
+		{
+			if (totalSize > m_reassemblyLimit || m_reassemblyBytes > (m_reassemblyLimit - totalSize))
+			{
+				Log::Warn("Fragmented message doesn't fit in the reassembly memory. Dropping");
+				return nullptr;
+			}
+
+			FragmentAssembly& assembly = m_fragmentAssemblies[fragment->m_fragmentID];
+			assembly.m_messageID = fragment->m_messageID;
+			assembly.m_count = count;
+			assembly.m_received = 0;
+			assembly.m_data.resize(totalSize);
+			assembly.m_arrived.assign(count, false);
+			m_reassemblyBytes += totalSize;
+			it = m_fragmentAssemblies.find(fragment->m_fragmentID);
+		}
+
+		FragmentAssembly& assembly = it->second;
+		if (assembly.m_messageID != fragment->m_messageID || assembly.m_count != count || assembly.m_data.size() != totalSize)
+		{
+			Log::Warn("Received a fragment that doesn't match its message. Skipping");
+			return nullptr;
+		}
+
+		assembly.m_lastTime = now;
+		if (assembly.m_arrived[fragment->m_index]) { return nullptr; }
+
+		std::copy(fragment->m_data.begin(), fragment->m_data.end(), assembly.m_data.begin() + offset);
+		assembly.m_arrived[fragment->m_index] = true;
+		assembly.m_received++;
+		if (assembly.m_received < count) { return nullptr; }
+
+		// all the pieces are here, read the whole message and free the memory
+		std::unique_ptr<Message> message = GetMessageFromID((MessageIDs)assembly.m_messageID);
+		bool success = message && message->FromBuffer(assembly.m_data.data(), totalSize);
+		m_reassemblyBytes -= totalSize;
+		m_fragmentAssemblies.erase(it);
+
+		if (!success)
+		{
+			Log::Warn("Fragmented message failed to deserialize. Skipping");
+			return nullptr;
+		}
+
+		message->m_header = message->GenerateHeader();
+		message->m_header.m_sequence = fragment->m_header.m_sequence;
+		// the pieces came in order through its channel
+		message->m_header.m_channel = fragment->m_header.m_channel;
+		message->m_header.m_channelSequence = fragment->m_header.m_channelSequence;
+		return message;
+	}
+
+	void RemotePeer::DropStaleFragments(uint64_t now)
+	{
+		for (auto it = m_fragmentAssemblies.begin(); it != m_fragmentAssemblies.end();)
+		{
+			if ((now - it->second.m_lastTime) <= s_reassemblyTimeout)
+			{
+				it++;
+				continue;
+			}
+
+#if QUICKNET_VERBOSE
+			std::ostringstream ss;
+			ss << "Dropping fragmented message " << it->first << " with " << it->second.m_received << " of " << it->second.m_count << " pieces";
+			Log::Info(ss.str());
+#endif
+			m_reassemblyBytes -= (uint32_t)it->second.m_data.size();
+			it = m_fragmentAssemblies.erase(it);
+		}
+	}
+
+	void RemotePeer::SetMaximumDatagramSize(uint32_t bytes)
+	{
+		m_datagramCeiling = (bytes < s_minimumDatagramSize) ? s_minimumDatagramSize : ((bytes > s_maximumDatagramSize) ? s_maximumDatagramSize : bytes);
+		setPacketSize((m_packetSize > m_datagramCeiling) ? m_datagramCeiling : m_packetSize);
+
+		// search again up to the new limit
+		m_probeLow = m_packetSize;
+		m_probeHigh = m_datagramCeiling;
+		m_probeSize = 0;
+		m_probeAttempts = 0;
+		m_probing = (m_probeHigh - m_probeLow) >= s_probeGranularity;
+		m_nextSearchTime = 0;
+	}
+
+	bool RemotePeer::IsMTUProbeDue(uint64_t now)
+	{
+		if (!m_probing)
+		{
+			// look for a bigger size from time to time
+			if (now < m_nextSearchTime || m_packetSize >= m_datagramCeiling) { return false; }
+
+			m_probeLow = m_packetSize;
+			m_probeHigh = m_datagramCeiling;
+			m_probing = (m_probeHigh - m_probeLow) >= s_probeGranularity;
+			if (!m_probing)
+			{
+				m_nextSearchTime = now + s_probeRaiseTime;
+				return false;
+			}
+		}
+
+		// one probe at a time
+		if (m_probeSize != 0)
+		{
+			uint32_t timeout = m_rto * 2;
+			if ((now - m_probeSendTime) < timeout) { return false; }
+
+			m_probeAttempts++;
+			uint32_t size = m_probeSize;
+			m_probeSize = 0;
+			if (m_probeAttempts >= s_maximumProbeAttempts)
+			{
+				failMTUProbe(size, now);
+			}
+		}
+
+		return m_probing;
+	}
+
+	void RemotePeer::MTUProbeSent(uint16_t sequence, uint32_t size, uint64_t now)
+	{
+		m_probeSize = size;
+		m_probeSequence = sequence;
+		m_probeSendTime = now;
+	}
+
+	void RemotePeer::MTUProbeFailed(uint32_t size, uint64_t now)
+	{
+		m_probeSize = 0;
+		failMTUProbe(size, now);
+	}
+
+	void RemotePeer::ackMTUProbe(uint16_t sequence, uint64_t now)
+	{
+		if (m_probeSize == 0 || sequence != m_probeSequence) { return; }
+
+#if QUICKNET_VERBOSE
+		std::ostringstream ss;
+		ss << "PMTU: " << m_probeSize << " bytes get through";
+		Log::Info(ss.str());
+#endif
+		setPacketSize(m_probeSize);
+		m_probeLow = m_probeSize;
+		m_probeSize = 0;
+		m_probeAttempts = 0;
+
+		if ((m_probeHigh - m_probeLow) < s_probeGranularity)
+		{
+			m_probing = false;
+			m_nextSearchTime = now + s_probeRaiseTime;
+		}
+	}
+
+	void RemotePeer::failMTUProbe(uint32_t size, uint64_t now)
+	{
+		m_probeAttempts = 0;
+		m_probeHigh = (size > m_probeLow) ? (size - 1) : m_probeLow;
+
+		if ((m_probeHigh - m_probeLow) < s_probeGranularity)
+		{
+			m_probing = false;
+			m_nextSearchTime = now + s_probeRaiseTime;
+		}
+	}
+
+	void RemotePeer::checkBlackHole(uint64_t now)
+	{
+		if (m_bigPacketLosses < s_blackHoleLosses || m_packetSize <= s_basePacketSize) { return; }
+
+#if QUICKNET_VERBOSE
+		std::ostringstream ss;
+		ss << "PMTU: packets of " << m_packetSize << " bytes stopped getting through, back to " << s_basePacketSize;
+		Log::Info(ss.str());
+#endif
+		// search again below the size that stopped working
+		m_probeLow = s_basePacketSize;
+		m_probeHigh = m_packetSize - 1;
+		setPacketSize(s_basePacketSize);
+		m_probeSize = 0;
+		m_probeAttempts = 0;
+		m_probing = (m_probeHigh - m_probeLow) >= s_probeGranularity;
+		m_nextSearchTime = now + s_probeRaiseTime;
+		m_bigPacketLosses = 0;
+	}
+
+	void RemotePeer::setPacketSize(uint32_t bytes)
+	{
+		m_packetSize = bytes;
+		if (m_congestionController)
+		{
+			m_congestionController->SetPacketSize(bytes);
+		}
+	}
+
+	void RemotePeer::ackReliable(uint16_t sequence)
+	{
+		auto it = m_reliableMessages.find(sequence);
+		if (it == m_reliableMessages.end()) { return; }
+
+#if QUICKNET_VERBOSE
+		Log::Info("ACKS: acked reliable sequence found. deleting");
+#endif
+		// the RTT comes from the packet timestamps, which dont include the ack delay
+		auto time = m_seqtrackSent.find(sequence);
+		if (time != m_seqtrackSent.end())
+		{
+			m_reliableDue.erase(std::make_pair(reliableDueTime(time->second), sequence));
+			m_reliableReady.erase(std::make_pair(it->second->m_sendBy, sequence));
+			m_seqtrackSent.erase(time);
+		}
+		if (it->second->m_header.m_messageID == MessageIDs::BulkChunk)
+		{
+			m_bulkSender.ChunkAcked((MessageBulkChunk*)it->second.get());
+		}
+		releaseChannelSequence(it->second->m_header);
+		m_reliableMessages.erase(it);
+	}
+
+	void RemotePeer::ackRedundant(uint16_t sequence)
+	{
+		for (auto it = m_redundantMessages.begin(); it != m_redundantMessages.end(); it++)
+		{
+			if ((*it)->m_header.m_sequence == sequence)
+			{
+				m_redundantMessages.erase(it);
+				break;
+			}
+		}
 	}
 
 	void RemotePeer::SetSequenceIn(uint16_t value)
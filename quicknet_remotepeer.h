@@ -24,10 +24,14 @@
 #include <stdint.h>
 #include <memory>
 #include <deque>
+#include <vector>
+#include <set>
 #include "quicknet_address.h"
 #include "quicknet_peer.h"
 #include "quicknet_message.h"
-#include "quicknet_time.h"
+#include "quicknet_fec.h"
+#include "quicknet_congestion.h"
+#include "quicknet_bulktransfer.h"
 
 namespace quicknet
 {
@@ -36,10 +40,70 @@ namespace quicknet
 		uint32_t m_round; // so we know if the sequence already overflowed
 	};
 
+	struct ReliableTrackingEntry
+	{
+		uint64_t m_sendTime; // last time it went out
+		uint32_t m_timeout;  // retransmission timeout for this message (backed off on every resend)
+		uint32_t m_resends;  // how many times it was sent again
+		uint32_t m_skipped;  // how many times newer sequences were acked before this one
+	};
+
+	struct SentPacketEntry
+	{
+		uint64_t m_sendTime;
+		uint32_t m_bytes;
+		uint16_t m_sequence; // newest sequence inside, the packet is acked with it
+		bool     m_missed;   // an ack covered its sequence without acking it
+	};
+
+	struct HandleTrackingEntry
+	{
+		uint32_t m_handle;  // the one the game gave to the message
+		bool     m_reliable; // reliables are only lost when they expire, they keep going otherwise
+	};
+
+	struct FragmentHandleEntry
+	{
+		uint16_t m_remaining; // pieces not acked or lost yet
+		bool     m_lost;      // already reported, the first lost piece loses the whole message
+	};
+
+	struct FragmentAssembly
+	{
+		uint8_t  m_messageID;
+		uint16_t m_count;
+		uint16_t m_received;
+		uint64_t m_lastTime; // when the last piece arrived
+		std::vector<uint8_t> m_data;
+		std::vector<bool> m_arrived;
+	};
+
+	struct OutgoingChannel
+	{
+		NetChannelMode m_mode;
+		uint8_t  m_priority; // higher ones go first
+		uint16_t m_weight;   // share of the bytes between the channels of the same priority
+		int32_t  m_deficit;  // bytes it can still send in its turn
+		uint16_t m_sequence; // next channel sequence
+		std::deque<std::unique_ptr<Message>> m_pending;
+		// reliable ordered only, which of the sent ones were acked from the oldest unacked one (m_unackedBase) on
+		uint16_t m_unackedBase;
+		std::deque<bool> m_unacked;
+	};
+
+	struct IncomingChannel
+	{
+		uint16_t m_nextSequence; // next one to deliver if ordered, oldest one still accepted if sequenced
+		std::unordered_map<uint16_t, std::unique_ptr<Message>> m_early; // ordered ones waiting for the ones before
+	};
+
+	class MessageFragment;
+
 	class RemotePeer
 	{
 	public:
-		RemotePeer(Address address);
+		// now is the time snapshot of the peer that adds it, in microseconds
+		RemotePeer(Address address, uint64_t now);
 		~RemotePeer();
 
 		// address getter
@@ -49,24 +113,198 @@ namespace quicknet
 		const NetPeerState State() const { return m_state; }
 		void SetSate(NetPeerState state) { m_state = state; }
 
+		// the now parameters are the caller's time snapshot in microseconds, so a pass reads the clock once
 		// add message to send
-		void EnqueueMessage(std::unique_ptr<Message> message);
-		// add message to wait for ack
-		void RequeueMessage(std::unique_ptr<Message> message);
+		void EnqueueMessage(std::unique_ptr<Message> message, uint64_t now);
+		// add message to wait for ack (or to go again if its redundant)
+		void RequeueMessage(std::unique_ptr<Message> message, uint64_t now);
 
-		// get send-pending message
-		std::unique_ptr<Message> DequeueMessage();
-		// get ack-pending messages
-		std::unique_ptr<Message> DequeueReliableMessage();
+		// get send-pending message if it fits in maxSize bytes
+		std::unique_ptr<Message> DequeueMessage(uint32_t maxSize, uint64_t now);
+		// get an ack-pending message which timeout expired and fits in maxSize bytes
+		std::unique_ptr<Message> DequeueReliableMessage(uint32_t maxSize, uint64_t now);
+
+		// get a copy of a recently sent redundant message that fits in maxSize bytes
+		std::unique_ptr<Message> DequeueRedundantMessage(uint32_t maxSize, uint64_t now);
+		// get the next bulk transfer chunk if it fits in maxSize bytes and the round share allows it
+		std::unique_ptr<Message> DequeueBulkChunk(uint32_t maxSize);
+
+		// how many unacked copies of each redundant message kind go in every packet
+		void SetRedundancy(uint8_t copies) { m_redundancy = copies; }
+		uint8_t Redundancy() const { return m_redundancy; }
+
+		// how a numbered channel is sent and scheduled against the others (channel 0 keeps the message flags)
+		void SetChannel(uint8_t channel, NetChannelMode mode, uint8_t priority, uint16_t weight);
+		// the message flags once they go through the channel
+		uint8_t ChannelFlags(uint8_t channel, uint8_t flags) const;
+		// set the channel fields of an outgoing message header
+		void ApplyChannel(MessageHeader& header, uint8_t channel);
+		// put a received channeled message in order, moving the ones ready to process to the list
+		void ReceiveOnChannel(std::unique_ptr<Message> message, std::vector<std::unique_ptr<Message>>& ready);
+
+		// limits on the messages it holds, and what happens to a new one over them (0 for no limit)
+		void SetQueueLimits(uint32_t bytes, uint32_t messages, uint32_t reliables, NetQueuePolicy policy);
+		NetQueuePolicy QueuePolicy() const { return m_queuePolicy; }
+		// make room for a new message sent as count messages of bytes in total, dropping the oldest unreliables if the policy allows, false if they dont fit
+		// a keyed one only needs room for what it adds over the queued one it replaces
+		bool MakeRoom(const Message* message, uint32_t bytes, uint32_t count, bool reliable);
+		uint64_t QueueDropCount() const { return m_queueDropCount; }
+		uint64_t QueueRejectCount() const { return m_queueRejectCount; }
+		uint64_t SupersededCount() const { return m_supersededCount; }
+		// memory held for its messages: queued, unacked, redundant copies and reassembly
+		uint32_t HeldBytes() const;
 
 		// check if theres new messages to send
-		bool HaveMessagesPending() { return !m_pendingMessages.empty(); }
+		bool HaveMessagesPending() { return m_pendingCount != 0; }
+		uint32_t PendingCount() const { return m_pendingCount; }
+		uint32_t ReliablesInFlight() const { return (uint32_t)m_reliableMessages.size(); }
 		// check if theres non-ack'd reliables
 		bool HaveReliableMessagesPending() { return !m_reliableMessages.empty(); }
+		// check if any non-ack'd reliable needs to be sent again
+		bool HaveReliableMessagesDue(uint64_t now);
+		// check if a bulk chunk can go in this round
+		bool HaveBulkChunksReady() const { return m_roundBulkBudget > 0 && m_bulkSender.HasChunkReady(); }
+
+		// bulk transfers in both directions
+		BulkSender& GetBulkSender() { return m_bulkSender; }
+		BulkReceiver& GetBulkReceiver() { return m_bulkReceiver; }
+		// percent of the round budget bulk chunks can take
+		void SetBulkShare(uint8_t percent) { m_bulkShare = (percent > 100) ? 100 : percent; }
 
-		void UpdateRTT(uint32_t milliseconds);
+		// the times are all in microseconds
+		void UpdateRTT(uint32_t microseconds, uint64_t now);
+		// packet header timestamps, every packet with an echo gives an RTT sample
+		uint16_t LocalTimestamp(uint64_t now) const;
+		uint16_t EchoTimestamp(uint64_t now) const;
+		void ProcessTimestamps(uint16_t timestamp, uint16_t echoTimestamp, uint64_t now);
 		const uint32_t Ping() const { return m_ping; }
 		const uint32_t RTT()  const { return m_rtt; }
+		uint32_t RTTVariance() const { return m_rttVariance; }
+		// current retransmission timeout
+		uint32_t RTO()  const { return m_rto; }
+
+		// lowest RTT seen recently
+		uint32_t MinRTT() const { return m_minRTT; }
+
+		// bytes that can go out on every send tick
+		void SetSendBudget(uint32_t bytes) { m_sendBudget = bytes; }
+		uint32_t SendBudget() const { return m_sendBudget; }
+
+		// send rounds start every roundTime microseconds, shifted by the phase so peers dont start together
+		void SetSendPhase(uint64_t offset, uint64_t now) { m_nextRound = now + offset; }
+		void UpdateSendRound(uint64_t now, uint64_t roundTime);
+		// batched rounds open with the budget, immediate ones as soon as something is queued, coalesced ones once the packet fills or waited enough
+		void SetSendMode(NetSendMode mode, uint32_t window) { m_sendMode = mode; m_coalesceWindow = window; }
+		NetSendMode SendMode() const { return m_sendMode; }
+		// lower tiers skip rounds and get their budget on the ones they keep
+		void SetSendTier(NetSendTier tier, uint64_t now);
+		uint8_t RoundDivisor() const { return (uint8_t)(1 << m_sendTier); }
+		// the game queued something for it, an automatic tier goes back to full rate
+		void GameActivity(uint64_t now);
+
+		// share of the server-wide egress budget, each turn gives it a quantum of bytes per weight
+		void SetEgressWeight(uint16_t weight) { m_egressWeight = (weight == 0) ? 1 : weight; }
+		int32_t EgressDeficit() const { return m_egressDeficit; }
+		void EgressTurn(uint32_t quantum) { m_egressDeficit += (int32_t)(quantum * m_egressWeight); }
+		void EgressSent(uint32_t bytes) { m_egressDeficit -= (int32_t)bytes; }
+		// nothing left to send, the unused bytes dont carry over
+		void EgressIdle() { m_egressDeficit = (m_egressDeficit > 0) ? 0 : m_egressDeficit; }
+		// held back by the egress budget on this tick, and on the last one
+		void SetEgressDeferred(bool deferred) { m_egressDeferred = deferred; }
+		bool EgressDeferred() const { return m_egressDeferred; }
+		void SetEgressLate(bool late) { m_egressLate = late; }
+		bool EgressLate() const { return m_egressLate; }
+		// bytes of the messages queued and not sent yet
+		uint32_t PendingBytes() const { return m_pendingBytes; }
+		// a round stays open until its queues are empty or its budget is spent
+		bool IsRoundOpen() const { return m_roundOpen; }
+		void CloseRound() { m_roundOpen = false; }
+		uint32_t RoundBudget() const { return m_roundBudget; }
+
+		// packets of a round are spread at the pacing rate instead of going out together
+		uint32_t PacingRate(uint64_t roundTime) const;
+		bool IsPacketPaced(uint64_t nowMicroseconds) const { return nowMicroseconds >= m_nextPacketTime; }
+		uint64_t NextPacketTime() const { return m_nextPacketTime; }
+		// account a sent packet, the credit from before earliest is lost so bursts stay short
+		void PacePacket(uint32_t bytes, uint64_t roundTime, uint64_t earliest);
+
+		// congestion control, no controller means no limit
+		void SetCongestionController(std::unique_ptr<CongestionController> controller);
+		const CongestionController* GetCongestionController() const { return m_congestionController.get(); }
+		// keep track of a sent packet with sequenced messages until its acked or lost
+		void PacketSent(uint16_t sequence, uint32_t bytes, uint64_t now);
+		// how many more bytes the congestion window allows right now (after giving up on the timed out packets), none while the ack window is full
+		uint32_t CongestionWindowRoom(uint64_t now);
+		uint32_t BytesInFlight() const { return m_bytesInFlight; }
+
+		// estimated loss from the acks, 0.0f to 1.0f
+		float PacketLoss() const { return m_packetLoss; }
+
+		// path MTU discovery, packets start small and grow with every probe that gets acked
+		uint32_t MaximumPacketSize() const { return m_packetSize; }
+		// the biggest datagram we will probe for
+		void SetMaximumDatagramSize(uint32_t bytes);
+		bool IsMTUProbeDue(uint64_t now);
+		uint32_t NextMTUProbeSize() const { return m_probeLow + ((m_probeHigh - m_probeLow + 1) / 2); }
+		void MTUProbeSent(uint16_t sequence, uint32_t size, uint64_t now);
+		// the socket refused to send it, no need to wait for the timeout
+		void MTUProbeFailed(uint32_t size, uint64_t now);
+
+		// smallest size the packets can fall back to, messages that dont fit in it are fragmented
+		uint32_t FallbackPacketSize() const;
+		uint16_t NextFragmentID() { return m_fragmentIDOut++; }
+		// put a received piece in its place, returns the whole message once all of them arrived
+		std::unique_ptr<Message> AddFragment(const MessageFragment* fragment, uint64_t now);
+		// give up on the messages that stopped getting pieces
+		void DropStaleFragments(uint64_t now);
+		// memory the messages being put together can take
+		void SetReassemblyLimit(uint32_t bytes) { m_reassemblyLimit = bytes; }
+		uint32_t ReassemblyBytes() const { return m_reassemblyBytes; }
+
+		// forward error correction for outgoing packets
+		void SetFECEnabled(bool enable) { m_fecEnabled = enable; }
+		bool IsFECEnabled() const { return m_fecEnabled; }
+		uint8_t FECGroupSize() const { return FECGroupSizeForLoss(m_packetLoss); }
+		FECEncoder& GetFECEncoder() { return m_fecEncoder; }
+		FECDecoder& GetFECDecoder() { return m_fecDecoder; }
+
+		// remember a sent message handle until its sequence is acked or falls out of the ack window
+		void TrackHandle(uint16_t sequence, uint32_t handle, bool reliable);
+		// a fragmented message handle is resolved once all its pieces are
+		void TrackFragmentedHandle(uint32_t handle, uint16_t count);
+		// move the handles resolved since the last call to the given lists
+		bool TakeHandleNotifications(std::vector<uint32_t>& delivered, std::vector<uint32_t>& lost);
+		// the peer is going away, every handle still waiting for an answer (queued, in flight or in pieces) is lost
+		void LoseHandles();
+
+		// delayed acks for when we have nothing to send back
+		void AckablePacketReceived(uint64_t now);
+		bool IsAckDue(uint64_t maxDelay, uint64_t now) const;
+		// an ack from this sequence went out, the ones it covers are done
+		void AcksSent(uint16_t sequence);
+		// received sequences stay pending until an ack covers them
+		void AckableSequenceReceived(uint16_t sequence) { m_unackedSequences.push_back(sequence); }
+		// newest pending sequence too old for an ack from the current one (a burst brought more than the ack bits cover)
+		bool UncoveredSequence(uint16_t& sequence);
+		bool IsUncoveredAckDue(uint64_t now) const { return now >= m_uncoveredAckTime; }
+		void DelayUncoveredAcks(uint64_t until) { m_uncoveredAckTime = until; }
+		void SetAckFrequency(uint8_t packets) { m_ackFrequency = (packets == 0) ? 1 : packets; }
+		uint8_t AckFrequency() const { return m_ackFrequency; }
+
+		// messages dropped because their deadline passed
+		uint64_t DeadlineDropCount() const { return m_deadlineDropCount; }
+
+		// traffic counters
+		void CountSent(uint32_t bytes) { m_bytesSent += bytes; m_packetsSent++; }
+		void CountReceived(uint32_t bytes) { m_bytesReceived += bytes; m_packetsReceived++; }
+		uint64_t BytesSent() const { return m_bytesSent; }
+		uint64_t BytesReceived() const { return m_bytesReceived; }
+		uint64_t PacketsSent() const { return m_packetsSent; }
+		uint64_t PacketsReceived() const { return m_packetsReceived; }
+
+		// retransmission counters
+		uint64_t ResendCount() const { return m_resendCount; }
+		uint64_t FastResendCount() const { return m_fastResendCount; }
 
 		// sequence getters
 		const uint16_t CurrentSequenceIn()  const { return m_sequenceIn; }
@@ -83,19 +321,19 @@ namespace quicknet
 		void SaveReceivedSequence(uint16_t sequence, bool newer);
 		bool MessageDuplicated(uint16_t sequence);
 
-		// get a bitfield to acknowledge the last 32 messages
-		uint32_t GetAckBits();
-		void ProcessAckBits(uint16_t sequence, uint32_t ackbits);
+		// get a bitfield to acknowledge the 32 messages before the given one
+		uint32_t GetAckBits(uint16_t sequence);
+		void ProcessAckBits(uint16_t sequence, uint32_t ackbits, uint64_t now);
 
-		uint64_t MillisecondsSinceLastMessage() { return Utils::GetElapsedMilliseconds() - m_lastMessageTime; }
-		void  UpdateLastMessageTime() { m_lastMessageTime = Utils::GetElapsedMilliseconds(); }
+		uint64_t MicrosecondsSinceLastMessage(uint64_t now) const { return now - m_lastMessageTime; }
+		void  UpdateLastMessageTime(uint64_t now) { m_lastMessageTime = now; }
 
 		// check if we need to send KeepAlives
-		uint64_t MillisecondsSinceLastAck() { return Utils::GetElapsedMilliseconds() - m_lastAckTime; }
-		void  UpdateLastAckTime() { m_lastAckTime = Utils::GetElapsedMilliseconds(); }
+		uint64_t MicrosecondsSinceLastAck(uint64_t now) const { return now - m_lastAckTime; }
+		void  UpdateLastAckTime(uint64_t now) { m_lastAckTime = now; }
 
-		uint64_t MillisecondsSinceLastSend() const { return Utils::GetElapsedMilliseconds() - m_lastSend; }
-		void UpdateLastSend() { m_lastSend = Utils::GetElapsedMilliseconds(); }
+		uint64_t MicrosecondsSinceLastSend(uint64_t now) const { return now - m_lastSend; }
+		void UpdateLastSend(uint64_t now) { m_lastSend = now; }
 
 		// the ID in Peer m_peers
 		uint8_t m_assignedID;
@@ -104,9 +342,59 @@ namespace quicknet
 		NetPeerState m_state;
 		// the remote address
 		quicknet::Address m_address;
+		// when the given tracked reliable is due to be sent again (0 for right away)
+		uint64_t reliableDueTime(const ReliableTrackingEntry& entry) const;
+		// remove an ack'd reliable and take its RTT sample
+		void ackReliable(uint16_t sequence);
+		// remove an ack'd redundant copy
+		void ackRedundant(uint16_t sequence);
+		// resolve the sent packets acked with this sequence
+		void ackPacket(uint16_t sequence, uint64_t now);
+		// take the probed size if this sequence acks the probe in flight
+		void ackMTUProbe(uint16_t sequence, uint64_t now);
+		// shrink the search range after a probe failed too many times
+		void failMTUProbe(uint32_t size, uint64_t now);
+		// restart the search from the smallest size after big packets stopped getting through
+		void checkBlackHole(uint64_t now);
+		void setPacketSize(uint32_t bytes);
+		// mark the sent packets this ack covered without acking them
+		void markMissedPackets(uint16_t sequence);
+		// give up on the sent packets that should have been acked by now
+		void detectLostPackets(uint64_t now);
+		// report the handle of an ack'd sequence as delivered
+		void ackHandle(uint16_t sequence);
+		// report a handle as delivered or lost, once per message
+		void resolveHandle(uint32_t handle, bool delivered);
+		// check a message deadline, counting it as dropped if it passed
+		bool dropIfExpired(const Message* message, uint64_t now);
+		// whether a coalesced round can open, or should wait for more messages
+		bool isCoalescedReady(uint64_t now);
+		// change the current tier, the first round at full rate comes on the next tick
+		void applySendTier(NetSendTier tier, uint64_t now);
+		// get a channel, adding the ones up to it with the default settings
+		OutgoingChannel& outgoingChannel(uint8_t channel);
+		// whether a queued message goes unreliable, after its channel
+		bool isUnreliable(Message* message) const;
+		// whether the next message of a channel fits in maxSize bytes and the receiver can take it
+		bool isChannelReady(uint8_t channel, uint32_t maxSize) const;
+		// a sent message of a reliable ordered channel was acked or dropped, move its window
+		void releaseChannelSequence(const MessageHeader& header);
+		// drop the oldest queued unreliable of the lowest priority channel that has one but keep, false if none
+		bool dropOldestUnreliable(const Message* keep);
+		// the queued message with a key on a channel, nullptr if none
+		const Message* queuedWithKey(uint8_t channel, uint32_t key) const;
+		// make the older messages with the key of a new one stale, true if a queued one was replaced in place by it
+		bool supersede(OutgoingChannel& channel, std::unique_ptr<Message>& message);
+
 		// raw and smoothed latency values
 		uint32_t m_ping;
 		uint32_t m_rtt;
+		uint32_t m_rttVariance;
+		// retransmission timeout computed from the above
+		uint32_t m_rto;
+		// windowed minimum of the RTT samples
+		uint32_t m_minRTT;
+		uint64_t m_minRTTTime;
 		// current sequence id for both directions
 		uint16_t m_sequenceIn;
 		uint16_t m_sequenceOut;
@@ -114,17 +402,115 @@ namespace quicknet
 		uint32_t m_sequenceRound;
 		// hash map to keep track of message sequences
 		std::unordered_map<uint16_t, SequenceTrackingEntry> m_seqtrackReceived;
-		// hash map to keep track of reliable messages send times
-		std::unordered_map<uint16_t, uint64_t> m_seqtrackSent;
-		// queue of pending messages to send
-		std::deque<std::unique_ptr<Message>>  m_pendingMessages;
-		// queue of sent ack-pending reliable messages
-		std::deque<std::unique_ptr<Message>> m_reliableMessages;
+		// hash map to keep track of reliable messages send times and timeouts
+		std::unordered_map<uint16_t, ReliableTrackingEntry> m_seqtrackSent;
+		// last timestamp the remote peer sent and when it arrived
+		uint16_t m_remoteTimestamp;
+		uint64_t m_remoteTimestampTime;
+		// newest sequence the remote peer acknowledged
+		uint16_t m_lastAckedSequence;
+		uint32_t m_sendBudget;
+		// path MTU discovery
+		uint32_t m_packetSize;
+		uint32_t m_datagramCeiling;
+		uint32_t m_probeLow;
+		uint32_t m_probeHigh;
+		uint32_t m_probeSize; // in flight, 0 if none
+		uint16_t m_probeSequence;
+		uint64_t m_probeSendTime;
+		uint32_t m_probeAttempts;
+		bool m_probing;
+		uint64_t m_nextSearchTime;
+		uint32_t m_bigPacketLosses;
+		// send rounds and pacing
+		uint64_t m_nextRound;
+		bool m_roundOpen;
+		uint32_t m_roundBudget;
+		uint32_t m_roundBulkBudget;
+		uint64_t m_nextPacketTime; // microseconds
+		NetSendMode m_sendMode;
+		uint32_t m_coalesceWindow;
+		uint64_t m_roundTime; // the last one given, to find the next round when going back to full rate
+		NetSendTier m_sendTier; // the current one, never Automatic
+		bool m_automaticTier;
+		uint64_t m_lastActivity;
+		// queue limits
+		uint32_t m_queueByteLimit;
+		uint32_t m_queueMessageLimit;
+		uint32_t m_reliableLimit;
+		NetQueuePolicy m_queuePolicy;
+		uint64_t m_queueDropCount;
+		uint64_t m_queueRejectCount;
+		uint64_t m_supersededCount;
+		// server-wide egress scheduling
+		uint16_t m_egressWeight;
+		int32_t m_egressDeficit;
+		bool m_egressDeferred;
+		bool m_egressLate;
+		// packets in flight for the congestion controller
+		std::unique_ptr<CongestionController> m_congestionController;
+		std::deque<SentPacketEntry> m_sentPackets;
+		uint32_t m_bytesInFlight;
+		// smoothed ratio of sent sequences that were never acked
+		float m_packetLoss;
+		// queues of pending messages to send, one per channel
+		std::deque<OutgoingChannel> m_channels;
+		uint32_t m_pendingCount;
+		// wire size of the queued messages, and since when the queues are not empty
+		uint32_t m_pendingBytes;
+		uint64_t m_firstPendingTime;
+		// reliables among the queued ones, they count against the reliable limit before going out
+		uint32_t m_pendingReliables;
+		// channel whose turn it is between the ones of the same priority
+		uint8_t m_channelTurn;
+		// order of the channeled messages we receive
+		std::unordered_map<uint8_t, IncomingChannel> m_incomingChannels;
+		// sent ack-pending reliable messages by sequence, and their sequences by when they are due again (0 for a fast retransmit)
+		// once due they wait for a packet by their place in the send order
+		std::unordered_map<uint16_t, std::unique_ptr<Message>> m_reliableMessages;
+		std::set<std::pair<uint64_t, uint16_t>> m_reliableDue;
+		std::set<std::pair<uint64_t, uint16_t>> m_reliableReady;
+		// last sent unacked copies of redundant messages
+		std::deque<std::unique_ptr<Message>> m_redundantMessages;
+		uint8_t m_redundancy;
+		// bulk transfers and their share of every round
+		BulkSender m_bulkSender;
+		BulkReceiver m_bulkReceiver;
+		uint8_t m_bulkShare;
+		// handles of sent messages waiting for an ack, and the resolved ones not yet reported
+		std::unordered_map<uint16_t, HandleTrackingEntry> m_seqtrackHandles;
+		std::vector<uint32_t> m_deliveredHandles;
+		std::vector<uint32_t> m_lostHandles;
+		std::unordered_map<uint32_t, FragmentHandleEntry> m_fragmentHandles;
+		// fragmentation, outgoing message IDs and the incoming messages being put together
+		uint16_t m_fragmentIDOut;
+		std::unordered_map<uint16_t, FragmentAssembly> m_fragmentAssemblies;
+		uint32_t m_reassemblyBytes;
+		uint32_t m_reassemblyLimit;
+		// received packets we didn't ack yet, and when the first of them arrived
+		uint8_t m_ackFrequency;
+		uint32_t m_unackedPackets;
+		std::vector<uint16_t> m_unackedSequences;
+		uint64_t m_firstUnackedTime;
+		// when the uncovered sequences left over from the last pass get their acks
+		uint64_t m_uncoveredAckTime;
 		// last ack time
 		uint64_t m_lastAckTime;
 		// last time we received a message
 		uint64_t m_lastMessageTime;
 		// last time we sent something
 		uint64_t m_lastSend;
+		// parity groups for outgoing and incoming packets
+		bool m_fecEnabled;
+		FECEncoder m_fecEncoder;
+		FECDecoder m_fecDecoder;
+		// reliable resends (total and the ones triggered by skipped acks)
+		uint64_t m_resendCount;
+		uint64_t m_fastResendCount;
+		uint64_t m_deadlineDropCount;
+		uint64_t m_bytesSent;
+		uint64_t m_bytesReceived;
+		uint64_t m_packetsSent;
+		uint64_t m_packetsReceived;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,190 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Lock-free rings to pass work between threads
+// SPSCRing takes exactly one producer and one consumer, each side only writes its own index
+// MPSCRing takes any number of producers and one consumer, the producers claim slots with a CAS
+//
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace quicknet
+{
+	template <typename T>
+	class SPSCRing
+	{
+	public:
+		// the capacity is rounded up to a power of two
+		explicit SPSCRing(uint32_t capacity)
+			: m_slots(roundUp(capacity))
+			, m_mask((uint32_t)m_slots.size() - 1)
+			, m_head(0)
+			, m_cachedTail(0)
+			, m_tail(0)
+			, m_cachedHead(0)
+		{
+		}
+
+		// producer side, false if the ring is full (the value is left untouched then)
+		bool TryPush(T& value)
+		{
+			uint32_t head = m_head.load(std::memory_order_relaxed);
+			// the consumer index is only read again when the old copy says it's full
+			if (head - m_cachedTail > m_mask)
+			{
+				m_cachedTail = m_tail.load(std::memory_order_acquire);
+				if (head - m_cachedTail > m_mask) { return false; }
+			}
+
+			m_slots[head & m_mask] = std::move(value);
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer side, false if the ring is empty
+		bool TryPop(T& value)
+		{
+			uint32_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail == m_cachedHead)
+			{
+				m_cachedHead = m_head.load(std::memory_order_acquire);
+				if (tail == m_cachedHead) { return false; }
+			}
+
+			value = std::move(m_slots[tail & m_mask]);
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// only a snapshot when the other side is running
+		uint32_t Size() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+		uint32_t Capacity() const { return m_mask + 1; }
+
+	private:
+		static uint32_t roundUp(uint32_t capacity)
+		{
+			uint32_t size = 1;
+			while (size < capacity) { size <<= 1; }
+			return size;
+		}
+
+		std::vector<T> m_slots;
+		const uint32_t m_mask;
+		// each side on its own cache line, with its copy of the other index
+		// (padding instead of alignas, over-aligned members aren't honored by new before C++17)
+		uint8_t m_padding0[64];
+		std::atomic<uint32_t> m_head; // written by the producer
+		uint32_t m_cachedTail;
+		uint8_t m_padding1[64];
+		std::atomic<uint32_t> m_tail; // written by the consumer
+		uint32_t m_cachedHead;
+		uint8_t m_padding2[64];
+	};
+	template <typename T>
+	class MPSCRing
+	{
+	public:
+		// the capacity is rounded up to a power of two
+		explicit MPSCRing(uint32_t capacity)
+			: m_mask(roundUp(capacity) - 1)
+			, m_slots(new Slot[m_mask + 1])
+			, m_head(0)
+			, m_tail(0)
+		{
+			// a slot is free for the producer that claims its position, and ready once its sequence moves one past it
+			for (uint32_t i = 0; i <= m_mask; i++)
+			{
+				m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		// producer side from any thread, false if the ring is full (the value is left untouched then)
+		bool TryPush(T& value)
+		{
+			uint32_t head = m_head.load(std::memory_order_relaxed);
+			Slot* slot;
+			while (true)
+			{
+				slot = &m_slots[head & m_mask];
+				int32_t difference = (int32_t)(slot->m_sequence.load(std::memory_order_acquire) - head);
+				if (difference == 0)
+				{
+					if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) { break; }
+				}
+				else if (difference < 0)
+				{
+					// the consumer didn't free it yet
+					return false;
+				}
+				else
+				{
+					// another producer took it
+					head = m_head.load(std::memory_order_relaxed);
+				}
+			}
+
+			slot->m_value = std::move(value);
+			slot->m_sequence.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer side, false if the ring is empty or the next slot is still being written
+		bool TryPop(T& value)
+		{
+			Slot& slot = m_slots[m_tail & m_mask];
+			if ((int32_t)(slot.m_sequence.load(std::memory_order_acquire) - (m_tail + 1)) < 0) { return false; }
+
+			value = std::move(slot.m_value);
+			slot.m_sequence.store(m_tail + m_mask + 1, std::memory_order_release);
+			m_tail++;
+			return true;
+		}
+
+	private:
+		struct Slot
+		{
+			std::atomic<uint32_t> m_sequence;
+			T m_value;
+		};
+
+		static uint32_t roundUp(uint32_t capacity)
+		{
+			uint32_t size = 1;
+			while (size < capacity) { size <<= 1; }
+			return size;
+		}
+
+		const uint32_t m_mask;
+		std::unique_ptr<Slot[]> m_slots;
+		// the producers share the head, the consumer alone has the tail
+		uint8_t m_padding0[64];
+		std::atomic<uint32_t> m_head;
+		uint8_t m_padding1[64];
+		uint32_t m_tail;
+		uint8_t m_padding2[64];
+	};
+}
\ No newline at end of file
@@ -20,6 +20,7 @@
 // OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
 // EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <string.h>
 #include "quicknet_stream.h"
 
 namespace quicknet
@@ -170,6 +171,18 @@ namespace quicknet
 	}
 
 
+	bool Stream::WriteBytes(const uint8_t* data, uint32_t length)
+	{
+		if (fits(length))
+		{
+			memcpy(m_buffer + m_index, data, length);
+			m_index += length;
+			return true;
+		}
+		return false;
+	}
+
+
 	bool Stream::ReadByte(uint8_t& value)
 	{
 		if (fits(sizeof(uint8_t)))
@@ -270,6 +283,17 @@ namespace quicknet
 		return false;
 	}
 
+	bool Stream::ReadBytes(uint8_t* data, uint32_t length)
+	{
+		if (fits(length))
+		{
+			memcpy(data, m_buffer + m_index, length);
+			m_index += length;
+			return true;
+		}
+		return false;
+	}
+
 
 	bool Stream::DeSerializeByte(uint8_t& value)
 	{
@@ -362,6 +386,16 @@ namespace quicknet
 		return false;
 	}
 
+	bool Stream::DeSerializeBytes(uint8_t* data, uint32_t length)
+	{
+		switch (m_mode)
+		{
+		case NetStreamMode::Read:  return ReadBytes(data, length);  break;
+		case NetStreamMode::Write: return WriteBytes(data, length); break;
+		}
+		return false;
+	}
+
 	bool Stream::fits(uint32_t size)
 	{
 		return !((m_index + size) > m_length);
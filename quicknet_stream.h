@@ -67,6 +67,8 @@ namespace quicknet
 		bool Full() { return !(m_index < m_length); }
 		void Skip(uint32_t bytes) { m_index = (m_index + bytes > m_length) ? m_length : (m_index + bytes); }
 		void Rewind(uint32_t bytes) { m_index = (m_index - bytes > m_index) ? 0 : (m_index - bytes); };
+		uint32_t Position() const { return m_index; }
+		uint32_t Remaining() const { return m_length - m_index; }
 
 		// manual write
 		bool WriteByte(uint8_t value);
@@ -78,6 +80,7 @@ namespace quicknet
 		bool WriteULong(uint64_t value);
 		bool WriteFloat(float value);
 		bool WriteQFloat(float& value, float min, float max, float step);
+		bool WriteBytes(const uint8_t* data, uint32_t length);
 
 		// manual read
 		bool ReadByte(uint8_t& value);
@@ -89,6 +92,7 @@ namespace quicknet
 		bool ReadULong(uint64_t& value);
 		bool ReadFloat(float& value);
 		bool ReadQFloat(float& value, float min, float max, float step);
+		bool ReadBytes(uint8_t* data, uint32_t length);
 
 		// automatic methods
 		bool DeSerializeByte(uint8_t& value);
@@ -101,6 +105,7 @@ namespace quicknet
 		bool DeSerializeFloat(float& value);
 
 		bool DeSerializeQFloat(float& value, float min, float max, float step);
+		bool DeSerializeBytes(uint8_t* data, uint32_t length);
 
 	private:
 		bool fits(uint32_t size);
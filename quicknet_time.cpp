@@ -29,6 +29,15 @@
 #	include <unistd.h>
 #endif
 
+// the time stamp counter is read in a few cycles instead of going through the system clock
+// only with gcc/clang on 64 bits (128 bit products) and if the CPU says its invariant, checked on runtime
+#if !defined(_WIN32) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#	include <x86intrin.h>
+#	include <cpuid.h>
+#	include <atomic>
+#	define QUICKNET_TSC 1
+#endif
+
 namespace quicknet
 {
 	namespace Utils
@@ -42,45 +51,197 @@ namespace quicknet
 		*/
 
 #ifdef _WIN32
-		// multiplier 1 = seconds
-		uint64_t elapsedMonotonicTime(uint64_t multiplier)
+		// microseconds since the first call
+		uint64_t monotonicMicroseconds()
 		{
-			LARGE_INTEGER pcFreq;
-			QueryPerformanceFrequency(&pcFreq);
+			// the frequency is fixed at boot
+			static LARGE_INTEGER pcFreq = []() { LARGE_INTEGER frequency; QueryPerformanceFrequency(&frequency); return frequency; }();
 
 			LARGE_INTEGER counter;
 			QueryPerformanceCounter(&counter);
 
+			// split in whole seconds and the rest, multiplying the whole count overflows after a few days
 			static LONGLONG lastCounter = counter.QuadPart;
-			LONGLONG count = (counter.QuadPart - lastCounter) * multiplier;
-			return (uint64_t)(count / pcFreq.QuadPart);
+			LONGLONG count = counter.QuadPart - lastCounter;
+			return (uint64_t)((count / pcFreq.QuadPart) * 1000000 + ((count % pcFreq.QuadPart) * 1000000) / pcFreq.QuadPart);
 		}
 #else
-		uint64_t elapsedMonotonicTime(uint64_t multiplier)
+		// microseconds since the first call (vDSO, no system call)
+		uint64_t monotonicMicroseconds()
 		{
 			struct timespec time;
 			clock_gettime(CLOCK_MONOTONIC, &time);
 
 			static struct timespec lastTime = time;
-			uint64_t divider = 1000000000 / multiplier; // nanoseconds in a second
 
-			return ((time.tv_sec - lastTime.tv_sec) * multiplier + ((time.tv_nsec - lastTime.tv_nsec) / divider));
+			// the nanoseconds difference is negative half of the time, it has to be divided signed
+			int64_t nanoseconds = (int64_t)(time.tv_sec - lastTime.tv_sec) * 1000000000 + (int64_t)(time.tv_nsec - lastTime.tv_nsec);
+			return (uint64_t)(nanoseconds / 1000);
+		}
+#endif
+
+#if QUICKNET_TSC
+		// the system clock answers until the counter rate is measured over this long
+		static const uint64_t s_tscCalibrationTime = 20 * 1000;
+		// and it's measured again every so often, over the whole time since the start
+		static const uint64_t s_tscRecalibrationTime = 1000 * 1000;
+
+		struct TSCCalibration
+		{
+			uint64_t m_startCounter; // first reading and the system time then
+			uint64_t m_startTime;
+			uint64_t m_anchorCounter; // last calibration, times are counted from it
+			uint64_t m_anchorTime;
+			uint64_t m_scale; // microseconds per tick in 32.32 fixed point (0 until calibrated)
+			uint64_t m_nextCalibration;
+		};
+
+		// one calibration for every thread, so the times taken on the game and network threads compare
+		// behind a sequence lock: odd while a thread writes it, readers try again if it changed under them
+		struct TSCClock
+		{
+			std::atomic<uint32_t> m_sequence;
+			std::atomic<uint64_t> m_startCounter;
+			std::atomic<uint64_t> m_startTime;
+			std::atomic<uint64_t> m_anchorCounter;
+			std::atomic<uint64_t> m_anchorTime;
+			std::atomic<uint64_t> m_scale;
+			std::atomic<uint64_t> m_nextCalibration;
+		};
+
+		static TSCClock s_tscClock;
+		// a thread can still read an older rate than the one just measured, but never goes back itself
+		static thread_local uint64_t t_tscLastTime = 0;
+
+		static bool invariantTSC()
+		{
+			// advanced power management leaf, bit 8 of edx
+			unsigned int eax, ebx, ecx, edx;
+			if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) { return false; }
+			__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+			return (edx & (1 << 8)) != 0;
+		}
+
+		static void loadTSC(TSCCalibration& calibration)
+		{
+			calibration.m_startCounter = s_tscClock.m_startCounter.load(std::memory_order_relaxed);
+			calibration.m_startTime = s_tscClock.m_startTime.load(std::memory_order_relaxed);
+			calibration.m_anchorCounter = s_tscClock.m_anchorCounter.load(std::memory_order_relaxed);
+			calibration.m_anchorTime = s_tscClock.m_anchorTime.load(std::memory_order_relaxed);
+			calibration.m_scale = s_tscClock.m_scale.load(std::memory_order_relaxed);
+			calibration.m_nextCalibration = s_tscClock.m_nextCalibration.load(std::memory_order_relaxed);
+		}
+
+		static void readTSC(TSCCalibration& calibration)
+		{
+			uint32_t sequence;
+			do
+			{
+				sequence = s_tscClock.m_sequence.load(std::memory_order_acquire);
+				loadTSC(calibration);
+				std::atomic_thread_fence(std::memory_order_acquire);
+			} while ((sequence & 1) != 0 || s_tscClock.m_sequence.load(std::memory_order_relaxed) != sequence);
+		}
+
+		// only one thread writes it, the others keep the calibration they read
+		static bool lockTSC(TSCCalibration& calibration)
+		{
+			uint32_t sequence = s_tscClock.m_sequence.load(std::memory_order_relaxed);
+			if ((sequence & 1) != 0 || !s_tscClock.m_sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire)) { return false; }
+			std::atomic_thread_fence(std::memory_order_release);
+			// another thread may have written it since it was read
+			loadTSC(calibration);
+			return true;
+		}
+
+		static void unlockTSC(const TSCCalibration& calibration)
+		{
+			s_tscClock.m_startCounter.store(calibration.m_startCounter, std::memory_order_relaxed);
+			s_tscClock.m_startTime.store(calibration.m_startTime, std::memory_order_relaxed);
+			s_tscClock.m_anchorCounter.store(calibration.m_anchorCounter, std::memory_order_relaxed);
+			s_tscClock.m_anchorTime.store(calibration.m_anchorTime, std::memory_order_relaxed);
+			s_tscClock.m_scale.store(calibration.m_scale, std::memory_order_relaxed);
+			s_tscClock.m_nextCalibration.store(calibration.m_nextCalibration, std::memory_order_relaxed);
+			s_tscClock.m_sequence.fetch_add(1, std::memory_order_release);
+		}
+
+		static void calibrateTSC(TSCCalibration& calibration, uint64_t counter, uint64_t time, uint64_t systemTime)
+		{
+			calibration.m_scale = (uint64_t)((((unsigned __int128)(systemTime - calibration.m_startTime)) << 32) / (counter - calibration.m_startCounter));
+			calibration.m_anchorCounter = counter;
+			// never go back, the next rate makes up for the difference
+			calibration.m_anchorTime = (time > systemTime) ? time : systemTime;
+			calibration.m_nextCalibration = calibration.m_anchorTime + s_tscRecalibrationTime;
+		}
+
+		static uint64_t tscTime(const TSCCalibration& calibration, uint64_t counter)
+		{
+			// a thread can read the counter just before another one anchors a calibration on a later reading
+			if (counter <= calibration.m_anchorCounter) { return calibration.m_anchorTime; }
+			return calibration.m_anchorTime + (uint64_t)(((unsigned __int128)(counter - calibration.m_anchorCounter) * calibration.m_scale) >> 32);
+		}
+
+		static uint64_t tscMicroseconds()
+		{
+			uint64_t counter = __rdtsc();
+			TSCCalibration calibration;
+			readTSC(calibration);
+
+			uint64_t time;
+			if (calibration.m_scale == 0)
+			{
+				time = monotonicMicroseconds();
+				if (lockTSC(calibration))
+				{
+					if (calibration.m_startCounter == 0)
+					{
+						calibration.m_startCounter = counter;
+						calibration.m_startTime = time;
+					}
+					else if (calibration.m_scale == 0 && (time - calibration.m_startTime) >= s_tscCalibrationTime && counter > calibration.m_startCounter)
+					{
+						calibrateTSC(calibration, counter, time, time);
+					}
+					unlockTSC(calibration);
+				}
+			}
+			else
+			{
+				time = tscTime(calibration, counter);
+				if (time >= calibration.m_nextCalibration && lockTSC(calibration))
+				{
+					if (time >= calibration.m_nextCalibration)
+					{
+						calibrateTSC(calibration, counter, tscTime(calibration, counter), monotonicMicroseconds());
+						time = calibration.m_anchorTime;
+					}
+					unlockTSC(calibration);
+				}
+			}
+
+			if (time < t_tscLastTime) { return t_tscLastTime; }
+			t_tscLastTime = time;
+			return time;
 		}
 #endif
 
 		uint64_t GetElapsedSeconds()
 		{
-			return elapsedMonotonicTime(1);
+			return GetElapsedMicroseconds() / 1000000;
 		}
 
 		uint64_t GetElapsedMilliseconds()
 		{
-			return elapsedMonotonicTime(1000);
+			return GetElapsedMicroseconds() / 1000;
 		}
 
 		uint64_t GetElapsedMicroseconds()
 		{
-			return elapsedMonotonicTime(1000000);
+#if QUICKNET_TSC
+			static const bool useTSC = invariantTSC();
+			if (useTSC) { return tscMicroseconds(); }
+#endif
+			return monotonicMicroseconds();
 		}
 
 		void SleepSeconds(uint32_t seconds)
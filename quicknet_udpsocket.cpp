@@ -33,6 +33,8 @@ namespace quicknet
 #	define SOCKET_ERROR   ( (int32_t)-1 )
 
 #	include <errno.h>
+#	include <string.h>
+#	include <sys/uio.h>
 
 // socket option parameter pointer type
 #	define sockoptpp const void*
@@ -54,10 +56,13 @@ namespace quicknet
 	}
 #endif
 
-	static const uint32_t s_defaultMTU = 1400;
+	// biggest UDP payload over IPv4
+	static const uint32_t s_maximumDatagramSize = 65507;
 	// TODO: set these to (lower) good values
 	static const int32_t s_receiveBufferSize = 256 * 1024;
 	static const int32_t s_sendBufferSize = 256 * 1024;
+	// datagrams handed to the kernel on each batch call
+	static const uint32_t s_maximumBatchSize = 64;
 
 	UDPSocket::UDPSocket(RawSocket udpSocket)
 	{
@@ -131,9 +136,9 @@ namespace quicknet
 	{
 		if (!this->IsValid() || (data == nullptr)) { return false; }
 
-		if (dataLength >= s_defaultMTU)
+		if (dataLength > s_maximumDatagramSize)
 		{
-			Log::Warn("Trying to send a buffer bigger than MTU");
+			Log::Warn("Trying to send a buffer bigger than the maximum datagram size");
 		}
 
 		int32_t result = sendto(m_udpSocket, (const char*)data, dataLength, 0, &remote.SockAddrc(), sizeof(remote.SockAddrc()));
@@ -145,6 +150,49 @@ namespace quicknet
 		return true;
 	}
 
+	uint32_t UDPSocket::SendBatch(const UDPDatagram* datagrams, uint32_t count)
+	{
+		if (!this->IsValid() || (datagrams == nullptr)) { return 0; }
+
+#if defined(__linux__)
+		struct mmsghdr headers[s_maximumBatchSize];
+		struct iovec buffers[s_maximumBatchSize];
+		uint32_t done = 0;
+		while (done < count)
+		{
+			uint32_t amount = ((count - done) < s_maximumBatchSize) ? (count - done) : s_maximumBatchSize;
+			memset(headers, 0, sizeof(headers[0]) * amount);
+			for (uint32_t i = 0; i < amount; i++)
+			{
+				const UDPDatagram& datagram = datagrams[done + i];
+				buffers[i].iov_base = datagram.m_data;
+				buffers[i].iov_len = datagram.m_length;
+				headers[i].msg_hdr.msg_name = (void*)&datagram.m_remote->SockAddrc();
+				headers[i].msg_hdr.msg_namelen = sizeof(datagram.m_remote->SockAddrc());
+				headers[i].msg_hdr.msg_iov = &buffers[i];
+				headers[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			int32_t result = sendmmsg(m_udpSocket, headers, amount, 0);
+			if (result == SOCKET_ERROR) { break; }
+			done += (uint32_t)result;
+			// a short count means the next one failed
+			if ((uint32_t)result < amount) { break; }
+		}
+		return done;
+#else
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t sent = 0;
+			if (!Send(*datagrams[i].m_remote, datagrams[i].m_data, datagrams[i].m_length, &sent))
+			{
+				return i;
+			}
+		}
+		return count;
+#endif
+	}
+
 	bool UDPSocket::Recv(uint8_t* buffer, uint32_t bufferSize, uint32_t* bytesRead, Address& remote)
 	{
 		if (!this->IsValid() || (buffer == nullptr)) { return false; }
@@ -193,6 +241,30 @@ namespace quicknet
 		return (success == SOCKET_ERROR);
 	}
 
+	bool UDPSocket::SetDontFragment(bool enable)
+	{
+		if (!this->IsValid()) { return false; }
+
+#if defined(_WIN32)
+		DWORD value = enable ? 1 : 0;
+		int32_t success = setsockopt(m_udpSocket, IPPROTO_IP, IP_DONTFRAGMENT, (sockoptpp)&value, sizeof(value));
+#elif defined(IP_MTU_DISCOVER)
+		// probe mode sets DF but ignores the path MTU the kernel cached, we do our own discovery
+#	ifdef IP_PMTUDISC_PROBE
+		int32_t value = enable ? IP_PMTUDISC_PROBE : IP_PMTUDISC_DONT;
+#	else
+		int32_t value = enable ? IP_PMTUDISC_DO : IP_PMTUDISC_DONT;
+#	endif
+		int32_t success = setsockopt(m_udpSocket, IPPROTO_IP, IP_MTU_DISCOVER, (sockoptpp)&value, sizeof(value));
+#elif defined(IP_DONTFRAG)
+		int32_t value = enable ? 1 : 0;
+		int32_t success = setsockopt(m_udpSocket, IPPROTO_IP, IP_DONTFRAG, (sockoptpp)&value, sizeof(value));
+#else
+		int32_t success = SOCKET_ERROR;
+#endif
+		return (success != SOCKET_ERROR);
+	}
+
 	bool UDPSocket::IsValid()
 	{
 		return m_udpSocket != INVALID_SOCKET;
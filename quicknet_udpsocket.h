@@ -35,6 +35,14 @@ namespace quicknet
 	typedef int32_t RawSocket;
 #endif
 
+	// one datagram of a batch send
+	struct UDPDatagram
+	{
+		const Address* m_remote;
+		uint8_t* m_data;
+		uint32_t m_length;
+	};
+
 	class UDPSocket
 	{
 	public:
@@ -46,11 +54,16 @@ namespace quicknet
 		bool Close();
 		bool Bind(const Address& address);
 		bool Send(const Address& remote, uint8_t* data, uint32_t dataLength, uint32_t* bytesSent);
+		// send them in order with as few system calls as the platform allows (sendmmsg on linux)
+		// returns how many went out, it stops at the first one that fails
+		uint32_t SendBatch(const UDPDatagram* datagrams, uint32_t count);
 		bool Recv(uint8_t* buffer, uint32_t bufferSize, uint32_t* bytesRead, Address& remote);
 
 		// handy methods
 		bool SetTimeout(int32_t timeout);
 		bool AllowBroadcast(bool allow);
+		// set the DF bit and never fragment locally, so path MTU probes fail instead of being split
+		bool SetDontFragment(bool enable);
 		bool IsValid();
 
 	private:
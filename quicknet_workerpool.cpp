@@ -0,0 +1,118 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "quicknet_workerpool.h"
+
+namespace quicknet
+{
+	WorkerPool::WorkerPool(uint32_t threads)
+		: m_threads()
+		, m_mutex()
+		, m_wake()
+		, m_done()
+		, m_job(nullptr)
+		, m_count(0)
+		, m_next(0)
+		, m_run(0)
+		, m_busy(0)
+		, m_stopping(false)
+	{
+		for (uint32_t i = 0; i < threads; i++)
+		{
+			m_threads.emplace_back(&WorkerPool::threadLoop, this, i + 1);
+		}
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		for (std::thread& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	void WorkerPool::Run(uint32_t count, const std::function<void(uint32_t, uint32_t)>& job)
+	{
+		if (count == 0) { return; }
+
+		// not worth waking anyone for a single job
+		if (m_threads.empty() || count == 1)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				job(0, i);
+			}
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job = &job;
+			m_count = count;
+			m_next.store(0, std::memory_order_relaxed);
+			m_busy = (uint32_t)m_threads.size();
+			m_run++;
+		}
+		m_wake.notify_all();
+
+		work(0);
+
+		// the job and its captures must outlive every thread that may still look at them
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_busy == 0; });
+		m_job = nullptr;
+	}
+
+	void WorkerPool::threadLoop(uint32_t worker)
+	{
+		uint32_t seen = 0;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_wake.wait(lock, [this, seen]() { return m_stopping || m_run != seen; });
+			if (m_stopping) { return; }
+			seen = m_run;
+
+			lock.unlock();
+			work(worker);
+			lock.lock();
+
+			if (--m_busy == 0)
+			{
+				m_done.notify_one();
+			}
+		}
+	}
+
+	void WorkerPool::work(uint32_t worker)
+	{
+		for (uint32_t i = m_next.fetch_add(1, std::memory_order_relaxed); i < m_count; i = m_next.fetch_add(1, std::memory_order_relaxed))
+		{
+			(*m_job)(worker, i);
+		}
+	}
+}
\ No newline at end of file
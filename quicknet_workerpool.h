@@ -0,0 +1,69 @@
+// Copyright (c) 2017 Santiago Fernandez Ortiz
+// 
+// Redistribution and use in source and binary forms, with or without modification, 
+// are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, 
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, 
+// this list of conditions and the following disclaimer in the documentation 
+// and/or other materials provided with the distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+// EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+//
+// Small pool of threads that share a list of independent jobs with the calling thread
+// Each thread takes the next job left from a shared counter, so a slow job doesn't hold back the rest
+//
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace quicknet
+{
+	class WorkerPool
+	{
+	public:
+		// threads besides the calling one
+		explicit WorkerPool(uint32_t threads);
+		~WorkerPool();
+
+		uint32_t Threads() const { return (uint32_t)m_threads.size(); }
+
+		// call job(worker, index) for every index below count, on the pool and the calling thread
+		// worker is 0 on the calling thread and 1 to Threads() on the others, it returns once every job is done
+		void Run(uint32_t count, const std::function<void(uint32_t, uint32_t)>& job);
+
+	private:
+		void threadLoop(uint32_t worker);
+		void work(uint32_t worker);
+
+		std::vector<std::thread> m_threads;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		// the current run, set under the lock before the threads are woken
+		const std::function<void(uint32_t, uint32_t)>* m_job;
+		uint32_t m_count;
+		std::atomic<uint32_t> m_next;
+		uint32_t m_run;
+		// threads still inside the current run
+		uint32_t m_busy;
+		bool m_stopping;
+	};
+}
\ No newline at end of file
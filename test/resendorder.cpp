@@ -0,0 +1,51 @@
+
+// Reliable resend order check
+// Two reliables go out and no ack comes back, the one sent last has the earlier deadline
+// once both are due again it has to be resent first, earliest deadline first like the queued messages
+
+#include <cstdio>
+#include <iostream>
+#include "quicknet_remotepeer.h"
+#include "quicknet_messagetypes.h"
+
+static const uint64_t s_start = 1000 * 1000;
+static const uint32_t s_maxSize = 1200;
+
+// queue it, take it out like a packet would and keep it waiting for its ack
+static void send(quicknet::RemotePeer& peer, uint16_t sequence, uint64_t deadline, uint64_t now)
+{
+	std::unique_ptr<quicknet::MessageTest> message = quicknet::MessageTest::Create();
+	message->m_testValue = (uint8_t)sequence;
+	message->m_channel = 1;
+	message->m_deadline = deadline;
+	peer.EnqueueMessage(std::move(message), now);
+
+	std::unique_ptr<quicknet::Message> sent = peer.DequeueMessage(s_maxSize, now);
+	sent->m_header = sent->GenerateHeader();
+	peer.ApplyChannel(sent->m_header, sent->m_channel);
+	sent->m_header.m_sequence = sequence;
+	peer.RequeueMessage(std::move(sent), now);
+}
+
+int main()
+{
+	// the log would fill the console
+	std::cout.rdbuf(nullptr);
+
+	quicknet::RemotePeer peer(quicknet::Address("127.0.0.1", 8000), s_start);
+	peer.SetChannel(1, quicknet::NetChannelMode::ReliableUnordered, 0, 1);
+
+	// the first one is due again first, but the second one expires first
+	send(peer, 1, s_start + 10 * 1000 * 1000, s_start);
+	send(peer, 2, s_start + 5 * 1000 * 1000, s_start + 50 * 1000);
+
+	// well past the initial timeout of both
+	uint64_t now = s_start + 1000 * 1000;
+	std::unique_ptr<quicknet::Message> first = peer.DequeueReliableMessage(s_maxSize, now);
+	std::unique_ptr<quicknet::Message> second = peer.DequeueReliableMessage(s_maxSize, now);
+
+	bool passed = first && second && (first->m_header.m_sequence == 2) && (second->m_header.m_sequence == 1);
+	printf("resend order: %u then %u, %s\n", first ? first->m_header.m_sequence : 0, second ? second->m_header.m_sequence : 0,
+		passed ? "earliest deadline first" : "FAILED");
+	return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+
+// Loopback throughput benchmark
+// The client queues a burst of messages at once and the server reports how fast they arrive
+// Then the server sends a burst to several clients, without send workers, with one and with more building their packets
+// throughput [workers] sets how many the last run has (one per spare core by default)
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <thread>
+#include "quicknet_peer.h"
+#include "quicknet_messagetypes.h"
+#include "quicknet_time.h"
+
+class BenchServer : public quicknet::Peer
+{
+public:
+	BenchServer()
+		: Peer(true, 8)
+	{
+	}
+
+	void OnConnection(uint8_t playerID) override {}
+	void OnDisconnection(uint8_t playerID) override {}
+	void OnGameMessage(const quicknet::Message* const message) override {}
+};
+
+class BenchClient : public quicknet::Peer
+{
+public:
+	BenchClient()
+		: Peer(false, 1)
+	{
+	}
+
+	void OnConnection(uint8_t playerID) override {}
+	void OnDisconnection(uint8_t playerID) override {}
+	void OnGameMessage(const quicknet::Message* const message) override {}
+};
+
+// burst size and how long we wait for it at most
+static const uint32_t s_burstMessages = 100000;
+static const uint64_t s_maximumTime = 10 * 1000;
+static const uint64_t s_warmupTime = 1000;
+// fan-out clients, burst to each of them and most send workers of the last run by default
+static const uint32_t s_fanOutClients = 8;
+static const uint32_t s_fanOutMessages = 20000;
+static const uint32_t s_fanOutWorkers = 4;
+
+static void burst()
+{
+	BenchServer server;
+	BenchClient client;
+
+	client.ConnectTo(quicknet::Address("127.0.0.1", 8000));
+	while (client.NetworkState() != quicknet::NetPeerState::Connected)
+	{
+		server.UpdateNetwork();
+		client.UpdateNetwork();
+		quicknet::Utils::SleepMilliseconds(1);
+	}
+
+	// let path MTU discovery settle, its probes would count as received bytes
+	uint64_t warmup = quicknet::Utils::GetElapsedMilliseconds();
+	while ((quicknet::Utils::GetElapsedMilliseconds() - warmup) < s_warmupTime)
+	{
+		server.UpdateNetwork();
+		client.UpdateNetwork();
+		quicknet::Utils::SleepMilliseconds(1);
+	}
+
+	// the client is the first peer of the server
+	const uint8_t clientID = 1;
+	quicknet::NetPeerStats stats;
+	server.GetPeerStats(clientID, stats);
+	uint64_t startBytes = stats.m_bytesReceived;
+	uint64_t startPackets = stats.m_packetsReceived;
+
+	// level-load style burst
+	for (uint32_t i = 0; i < s_burstMessages; i++)
+	{
+		client.SendTo((uint8_t)0, quicknet::MessageTest::Create());
+	}
+	uint64_t burstBytes = (uint64_t)s_burstMessages * (quicknet::MessageHeader::Size() + quicknet::MessageTest().Size());
+
+	uint64_t start = quicknet::Utils::GetElapsedMilliseconds();
+	uint64_t elapsed = 0;
+	uint64_t received = 0;
+	while (elapsed < s_maximumTime && received < burstBytes)
+	{
+		server.UpdateNetwork();
+		client.UpdateNetwork();
+		quicknet::Utils::SleepMilliseconds(1);
+
+		server.GetPeerStats(clientID, stats);
+		received = stats.m_bytesReceived - startBytes;
+		elapsed = quicknet::Utils::GetElapsedMilliseconds() - start;
+	}
+
+	elapsed = (elapsed == 0) ? 1 : elapsed;
+	printf("received %llu bytes in %llu packets over %llu ms: %.1f KB/s\n",
+		(unsigned long long)received, (unsigned long long)(stats.m_packetsReceived - startPackets),
+		(unsigned long long)elapsed, (double)received / (double)elapsed * 1000.0 / 1024.0);
+}
+
+static void fanOut(uint32_t workers)
+{
+	BenchServer server;
+	std::vector<std::unique_ptr<BenchClient>> clients;
+	for (uint32_t i = 0; i < s_fanOutClients; i++)
+	{
+		clients.emplace_back(new BenchClient());
+		clients.back()->ConnectTo(quicknet::Address("127.0.0.1", 8000));
+	}
+
+	// connect and let path MTU discovery settle
+	uint64_t warmup = quicknet::Utils::GetElapsedMilliseconds();
+	while ((quicknet::Utils::GetElapsedMilliseconds() - warmup) < s_warmupTime)
+	{
+		server.UpdateNetwork();
+		for (std::unique_ptr<BenchClient>& client : clients)
+		{
+			client->UpdateNetwork();
+		}
+		quicknet::Utils::SleepMilliseconds(1);
+	}
+	server.SetSendWorkers(workers);
+
+	// the server is the only peer of every client
+	quicknet::NetPeerStats stats;
+	std::vector<uint64_t> startBytes;
+	for (std::unique_ptr<BenchClient>& client : clients)
+	{
+		client->GetPeerStats(0, stats);
+		startBytes.push_back(stats.m_bytesReceived);
+	}
+
+	for (uint32_t i = 0; i < s_fanOutMessages; i++)
+	{
+		server.SendToAll(quicknet::MessageTest::Create());
+	}
+	uint64_t burstBytes = (uint64_t)s_fanOutClients * s_fanOutMessages * (quicknet::MessageHeader::Size() + quicknet::MessageTest().Size());
+
+	uint64_t start = quicknet::Utils::GetElapsedMilliseconds();
+	uint64_t elapsed = 0;
+	uint64_t received = 0;
+	uint64_t updateTime = 0;
+	uint64_t updates = 0;
+	while (elapsed < s_maximumTime && received < burstBytes)
+	{
+		// the server update is where the workers build the packets
+		uint64_t updateStart = quicknet::Utils::GetElapsedMicroseconds();
+		server.UpdateNetwork();
+		updateTime += quicknet::Utils::GetElapsedMicroseconds() - updateStart;
+		updates++;
+
+		received = 0;
+		for (uint32_t i = 0; i < s_fanOutClients; i++)
+		{
+			clients[i]->UpdateNetwork();
+			clients[i]->GetPeerStats(0, stats);
+			received += stats.m_bytesReceived - startBytes[i];
+		}
+		quicknet::Utils::SleepMilliseconds(1);
+		elapsed = quicknet::Utils::GetElapsedMilliseconds() - start;
+	}
+
+	elapsed = (elapsed == 0) ? 1 : elapsed;
+	printf("%u clients, %u send workers on %u cores: received %llu bytes over %llu ms: %.1f KB/s, %.1f us per server update\n",
+		s_fanOutClients, workers, std::thread::hardware_concurrency(), (unsigned long long)received, (unsigned long long)elapsed,
+		(double)received / (double)elapsed * 1000.0 / 1024.0, (double)updateTime / (double)updates);
+}
+
+int main(int argc, char** argv)
+{
+	// the log would measure the console instead of the network
+	std::cout.rdbuf(nullptr);
+
+	burst();
+	// the workers only help with cores to spare besides the updating thread
+	uint32_t cores = std::thread::hardware_concurrency();
+	uint32_t workers = (cores > 1) ? (cores - 1) : 1;
+	workers = (workers > s_fanOutWorkers) ? s_fanOutWorkers : workers;
+	if (argc > 1)
+	{
+		workers = (uint32_t)atoi(argv[1]);
+	}
+	fanOut(0);
+	fanOut(1);
+	if (workers > 1)
+	{
+		fanOut(workers);
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+
+// High tick rate benchmark
+// A server with 64 clients on loopback, everyone sends a small message on every tick
+// and the server reports how much time its updates take per tick at each rate
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <memory>
+#include "quicknet_peer.h"
+#include "quicknet_messagetypes.h"
+#include "quicknet_time.h"
+
+class BenchServer : public quicknet::Peer
+{
+public:
+	BenchServer(uint8_t maxPeers)
+		: Peer(true, maxPeers)
+	{
+	}
+
+	void OnConnection(uint8_t playerID) override {}
+	void OnDisconnection(uint8_t playerID) override {}
+	void OnGameMessage(const quicknet::Message* const message) override {}
+};
+
+class BenchClient : public quicknet::Peer
+{
+public:
+	BenchClient()
+		: Peer(false, 1)
+	{
+	}
+
+	void OnConnection(uint8_t playerID) override {}
+	void OnDisconnection(uint8_t playerID) override {}
+	void OnGameMessage(const quicknet::Message* const message) override {}
+};
+
+static const uint8_t s_clients = 64;
+static const uint32_t s_rates[] = { 20, 60, 128 };
+// microseconds measured at each rate
+static const uint64_t s_measureTime = 3 * 1000 * 1000;
+static const uint64_t s_connectTime = 10 * 1000 * 1000;
+
+int main()
+{
+	// the log would measure the console instead of the network
+	std::cout.rdbuf(nullptr);
+
+	BenchServer server(s_clients);
+	std::vector<std::unique_ptr<BenchClient>> clients;
+	for (uint8_t i = 0; i < s_clients; i++)
+	{
+		clients.emplace_back(new BenchClient());
+		clients.back()->ConnectTo(quicknet::Address("127.0.0.1", 8000));
+	}
+
+	uint64_t start = quicknet::Utils::GetElapsedMicroseconds();
+	uint32_t connected = 0;
+	while (connected < s_clients && (quicknet::Utils::GetElapsedMicroseconds() - start) < s_connectTime)
+	{
+		server.UpdateNetwork();
+		connected = 0;
+		for (std::unique_ptr<BenchClient>& client : clients)
+		{
+			client->UpdateNetwork();
+			connected += (client->NetworkState() == quicknet::NetPeerState::Connected) ? 1 : 0;
+		}
+		quicknet::Utils::SleepMilliseconds(1);
+	}
+	printf("%u of %u clients connected\n", connected, (uint32_t)s_clients);
+
+	for (uint32_t rate : s_rates)
+	{
+		server.SetSendRate(rate);
+		for (std::unique_ptr<BenchClient>& client : clients)
+		{
+			client->SetSendRate(rate);
+		}
+
+		uint64_t tickTime = 1000 * 1000 / rate;
+		uint64_t serverTime = 0;
+		uint64_t worstUpdate = 0;
+		uint64_t ticks = 0;
+		uint64_t nextTick = quicknet::Utils::GetElapsedMicroseconds();
+		start = nextTick;
+		while ((quicknet::Utils::GetElapsedMicroseconds() - start) < s_measureTime)
+		{
+			// game state from everyone at the tick rate
+			uint64_t now = quicknet::Utils::GetElapsedMicroseconds();
+			if (now >= nextTick)
+			{
+				nextTick += tickTime;
+				ticks++;
+				for (std::unique_ptr<BenchClient>& client : clients)
+				{
+					client->SendTo((uint8_t)0, quicknet::MessageTest::Create());
+				}
+				server.SendToAll(quicknet::MessageTest::Create());
+			}
+
+			uint64_t before = quicknet::Utils::GetElapsedMicroseconds();
+			server.UpdateNetwork();
+			uint64_t update = quicknet::Utils::GetElapsedMicroseconds() - before;
+			serverTime += update;
+			worstUpdate = (update > worstUpdate) ? update : worstUpdate;
+
+			for (std::unique_ptr<BenchClient>& client : clients)
+			{
+				client->UpdateNetwork();
+			}
+			quicknet::Utils::SleepMicroseconds(200);
+		}
+
+		ticks = (ticks == 0) ? 1 : ticks;
+		printf("%u Hz with %u peers: %llu ticks, server updates take %.1f us per tick (%.2f%% of the tick), worst update %llu us\n",
+			rate, connected, (unsigned long long)ticks, (double)serverTime / (double)ticks,
+			(double)serverTime / (double)ticks / (double)tickTime * 100.0, (unsigned long long)worstUpdate);
+	}
+	return 0;
+}
\ No newline at end of file